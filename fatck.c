@@ -82,8 +82,15 @@
 #define FAT_SFN_EXTE_START  (0x08)
 #define FAT_SFN_EXTE_END    (0x0A)
 
-// long file name buffer length
-#define FAT_LFN_SIZE        (0x100)
+// long file name characters (20 entries of 13), utf-8 name buffer length
+#define FAT_LFN_CHARS       (0x104)
+#define FAT_LFN_SIZE        (FAT_LFN_CHARS * 3 + 1)
+// long file name ordinal, last entry flag and checksum of the short name
+#define FAT_LFN_ORD         (0x00)
+#define FAT_LFN_ORD_MASK    (0x1F)
+#define FAT_LFN_ORD_LAST    (0x40)
+#define FAT_LFN_CHKSUM      (0x0D)
+#define FAT_LFN_PART_CHARS  (0x0D)
 // long file name field 1
 #define FAT_LFN_1_START     (0x01)
 #define FAT_LFN_1_END       (0x0A)
@@ -97,6 +104,8 @@
 // dir is . or ..
 #define IS_CURRENT_DIR(x)   ((x[0] == 0x2E) && (x[1] == 0x20))
 #define IS_PARENTS_DIR(x)   ((x[0] == 0x2E) && (x[1] == 0x2E) && (x[2] == 0x20))
+// dir entry is deleted
+#define IS_DELETED_DIR(x)   (x[0] == 0xE5)
 
 // fatfs type
 #define FAT_TYPE_FAT12      (12)
@@ -122,8 +131,89 @@
 #define FAT32_CLUS_BAD(x)   ((x) == 0x0FFFFFF7)
 #define FAT32_CLUS_END(x)   ((x) >= 0x0FFFFFF8 && (x) <= 0x0FFFFFFF)
 
+// FAT entry width on disk (FAT32 entries keep 28 bits of 32)
+#define FAT_ENTRY_BITS(t)   (((t) == FAT_TYPE_FAT32) ? 32 : (t))
+// FAT table load block size (multiple of 3, 2 and 4 bytes)
+#define FAT_LOAD_SIZE       (0xC000)
+// parsed directory hash buckets
+#define FAT_DIR_BUCKETS     (0x1000)
+// disk order sweep staging buffer
+#define FAT_SWEEP_SIZE      (0x800000)
+// FAT mirror compare block size, and differing ranges printed per copy
+#define FAT_MIRROR_SIZE     (0x100000)
+#define FAT_MIRROR_REPORT   (0x20)
+// lost chains printed one by one, recovered file names FOUND.000 .. FOUND.999
+#define FAT_LOST_REPORT     (0x20)
+#define FAT_LOST_NAMES      (1000)
+// sidecar layout version, bumped whenever parsed directory results change
+#define FAT_SIDE_VERSION    (0x01)
+// chain readahead window in clusters, grows when a hop stalls
+#define FAT_RA_MIN          (2)
+#define FAT_RA_MAX          (64)
+#define FAT_RA_STALL_US     (200)
+
+// bytes of contiguous file clusters read and hashed at once
+#define FAT_DATA_RUN        (0x100000)
+// content state of a manifest file
+#define FAT_DATA_HASHED     (0)
+#define FAT_DATA_BROKEN     (1)
+#define FAT_DATA_SHORT      (2)
+#define FAT_DATA_UNREAD     (3)
+
+// change of a paired path between two images
+#define FAT_DIFF_ADDED      (0)
+#define FAT_DIFF_REMOVED    (1)
+#define FAT_DIFF_MODIFIED   (2)
+#define FAT_DIFF_COMPARE    (3)
+// what differs in a modified file
+#define FAT_DIFF_SIZE       (0x01)
+#define FAT_DIFF_ATTR       (0x02)
+#define FAT_DIFF_TIME       (0x04)
+#define FAT_DIFF_DATA       (0x08)
+#define FAT_DIFF_CHAIN      (0x10)
+#define FAT_DIFF_READ       (0x20)
+
+// FAT access under a memory cap, the whole table, a run index of its links or small decoded pages
+#define FAT_WIN_FULL        (0)
+#define FAT_WIN_RUNS        (1)
+#define FAT_WIN_PAGED       (2)
+// entries of one window, a FAT load block
+#define FAT_WIN_ENTRIES(t)  ((uint32_t)((FAT_LOAD_SIZE * 8) / FAT_ENTRY_BITS(t)))
+// budget of paged mode at the least in windows, and the mark of an empty slot
+#define FAT_WIN_SLOTS_MIN   (2)
+#define FAT_WIN_EMPTY       (0xFFFFFFFF)
+// entries of one paged slot, on an entry boundary of every FAT type, and the slots of one set
+#define FAT_WIN_PAGE        (0x400)
+#define FAT_WIN_WAYS        (4)
+// run index record whose entries all hold its tail value
+#define FAT_WIN_FILL        (0x80000000)
+
+// 2 bit cluster state, the high bit is set when a chain owns the cluster
+#define FAT_STATE_NONE      (0)
+#define FAT_STATE_LINKED    (1)
+#define FAT_STATE_OWNED     (2)
+#define FAT_STATE_CROSS     (3)
+
+// counters are atomic, pool threads read and parse side by side
+#ifndef FAT_STATS_DISABLE
+#define FAT_STAT_ADD(fc, field, delta)  fat_atomic_add64(&(fc)->stats.field, (uint64_t)(delta))
+#else
+#define FAT_STAT_ADD(fc, field, delta)  ((void)0)
+#endif
+
+// cluster bitmap access
+#define FAT_BIT_GET(m, i)   ((m)[(i) >> 3] & (1 << ((i) & 7)))
+#define FAT_BIT_SET(m, i)   ((m)[(i) >> 3] |= (uint8_t)(1 << ((i) & 7)))
+// cluster state map access, 4 clusters per byte
+#define FAT_STATE_GET(m, i)     (((m)[(i) >> 2] >> (((i) & 3) << 1)) & 3)
+#define FAT_STATE_PUT(m, i, s)  ((m)[(i) >> 2] = (uint8_t)(((m)[(i) >> 2] & ~(3 << (((i) & 3) << 1))) | ((s) << (((i) & 3) << 1))))
+
+#define FAT_FSINFO_LEADSIG  (0)
+#define FAT_FSINFO_STRUCSIG (484)
 #define FAT_FSINFO_FREECNT  (488)
 #define FAT_FSINFO_NEXTFREE (492)
+#define FAT_FSINFO_TRAILSIG (508)
+#define FAT_FSINFO_UNKNOWN  (0xFFFFFFFF)
 
 #define FAT_GET_UINT16(x)   ((*(x)) | (*((x) + 1) << 8))
 #define FAT_GET_UINT32(x)   ((uint32_t)*((x) + 0) << 0x00) | \
@@ -183,6 +273,7 @@ typedef struct fat_fs
     uint32_t data_clusters;
     uint32_t free_count;
     uint32_t next_free;
+    bool fsinfo_valid;
 
     uint32_t fats_sector_start;
     uint32_t fats_sector_count;
@@ -192,7 +283,83 @@ typedef struct fat_fs
     uint32_t data_sector_count;
 } fat_fs_t;
 
-typedef struct fat_ck
+typedef struct fat_run
+{
+    uint64_t addr;
+    uint32_t size;
+    const uint8_t* data;
+} fat_run_t;
+
+typedef struct fat_ra
+{
+    // next cluster to advise, clusters left in the chain.
+    uint32_t cluster;
+    uint32_t left;
+    uint32_t ahead;
+    uint32_t window;
+} fat_ra_t;
+
+typedef struct fat_chain
+{
+    uint32_t start;
+    uint32_t count;
+} fat_chain_t;
+
+typedef struct fat_data_file
+{
+    char* path;
+    uint32_t cluster;
+    uint32_t size;
+    uint32_t state;
+    uint32_t crc;
+} fat_data_file_t;
+
+typedef struct fat_win_run
+{
+    uint32_t first;
+    // entries of the run, FAT_WIN_FILL is set when they all hold tail instead of linking on.
+    uint32_t count;
+    uint32_t tail;
+} fat_win_run_t;
+
+typedef struct fat_win
+{
+    int mode;
+    // memory cap, what the whole table and the state map would take, and what was used.
+    uint64_t cap;
+    uint64_t full_bytes;
+    uint64_t state_bytes;
+    uint64_t used_bytes;
+    // load block and free bitmap kept in every mode, and what a windowed mode keeps besides runs or slots.
+    uint64_t work_bytes;
+    uint64_t fixed_bytes;
+    // a state map over the cap lives in a deleted temporary file and is not counted.
+    bool state_spill;
+    void* state_hand;
+    // entries of one window, the window streamed or scanned, and its free bitmap.
+    uint32_t entries;
+    uint32_t* buff;
+    uint8_t* free_bits;
+    // links of the whole FAT as runs sorted by first entry, while they fit the cap.
+    fat_win_run_t* runs;
+    uint32_t run_count;
+    uint32_t run_limit;
+    uint64_t run_budget;
+    // decoded pages in sets of slot_ways slots, the set of a page is its number modulo the set count.
+    uint32_t* slots;
+    uint32_t* slot_page;
+    uint64_t* slot_used;
+    uint32_t slot_count;
+    uint32_t slot_ways;
+    uint64_t tick;
+    uint8_t* raw;
+    fat_mutex_t lock;
+    // windows decoded again after the load pass, and whole FAT scans, the time the cap costs.
+    uint64_t loads;
+    uint32_t passes;
+} fat_win_t;
+
+struct fat_ck
 {
     fat_dev_t* device;
     fat_fs_t fatfs;
@@ -207,8 +374,71 @@ typedef struct fat_ck
     uint8_t  dir_deep;
     uint8_t* lfnbuf;
     uint8_t* fnbuf;
+    // decoded FAT, next cluster of each cluster in FAT32 value range, NULL when the cap keeps it windowed.
+    uint32_t* fat_table;
+    uint32_t fat_entries;
+    fat_win_t win;
+    // cluster counts by kind, and the first free cluster.
+    fat_clus_stat_t clus_stat;
+    uint32_t free_first;
+    // 2 bits per FAT entry, owned by a chain, owned by more than one, or linked from a lost cluster.
+    uint8_t* state_map;
+    uint32_t dup_count;
+    uint32_t own_count;
+    fat_chain_t* chains;
+    uint32_t chain_count;
+    uint32_t chain_limit;
+    // chains of used clusters no directory entry reaches.
+    fat_chain_t* lost;
+    uint32_t lost_count;
+    uint32_t lost_limit;
+    uint32_t lost_clusters;
+    // parsed directories by start cluster, filled by the traversal pool.
+    struct fat_dir_node** dir_nodes;
+    uint32_t dir_bucket_count;
+    fat_mutex_t dir_lock;
+    int threads;
+    // disk order sweep, staged runs of directory clusters.
+    bool io_order;
+    fat_run_t* runs;
+    uint32_t run_count;
+    uint8_t* sweep_buff;
+    // batch reads of unmapped runs.
+    fat_io_t* io;
+    fat_io_req_t* io_reqs;
+    uint32_t io_depth;
+    // repair write set, directories whose subtree was not walked.
+    fat_fix_t* fix;
+    char* journal;
+    uint32_t dirs_skipped;
+    // incremental check, the last run's sidecar and the one written by this run.
+    fat_side_t* side;
+    fat_side_t* side_next;
+    char* side_path;
+    volatile long dirs_reused;
+    volatile long dirs_parsed;
+    uint32_t fat_changed;
+    // counters and phase times, reported on request.
+    bool stats_report;
+    fat_ck_stats_t stats;
+    // content check, files in namespace order hashed into the manifest.
+    char* manifest;
+    fat_data_file_t* files;
+    uint32_t file_count;
+    uint32_t file_limit;
+    uint32_t file_mismatch;
+    // path of the directory being emitted, and one read buffer per hashing worker.
+    char* data_path;
+    size_t data_path_limit;
+    uint8_t** data_buffs;
+    // embedding callbacks, and whether the context has run.
+    fat_ck_callbacks_t calls;
+    bool done;
+    // report text is kept here when the check runs beside others.
+    fat_rep_t rep;
+    int result;
     int error;
-} fat_ck_t;
+};
 
 typedef struct fat_dir
 {
@@ -226,7 +456,109 @@ typedef struct fat_dir
     uint32_t DIR_FileSize;
 } fat_dir_t;
 
+typedef struct fat_dir_item
+{
+    fat_dir_t dir;
+    char* name;
+} fat_dir_item_t;
+
+typedef struct fat_dir_scan
+{
+    // one sector, used when the device is not mapped.
+    uint8_t* buff;
+    // long name fragments collected ahead of their short entry.
+    uint16_t lfn[FAT_LFN_CHARS];
+    uint8_t lfn_count;
+    uint8_t lfn_next;
+    uint8_t lfn_sum;
+    // chained hash of the parsed clusters, kept for the sidecar.
+    uint8_t* hash_buff;
+    uint64_t hash;
+    uint32_t hash_count;
+    // entries and clusters read, added to the stats once per directory.
+    uint32_t entries;
+    uint32_t clusters;
+} fat_dir_scan_t;
+
+typedef struct fat_dir_node
+{
+    uint32_t cluster;
+    fat_dir_item_t* items;
+    uint32_t item_count;
+    uint32_t item_limit;
+    // set once the diff has paired it, a directory loop is walked once.
+    bool visited;
+    struct fat_dir_node* hash;
+} fat_dir_node_t;
+
+typedef struct fat_diff_item
+{
+    char* path;
+    uint32_t change;
+    uint32_t reason;
+    fat_dir_t left;
+    fat_dir_t right;
+} fat_diff_item_t;
+
+typedef struct fat_diff
+{
+    fat_ck_t* left;
+    fat_ck_t* right;
+    int threads;
+    // changed paths in namespace order, and the path of the directory being paired.
+    fat_diff_item_t* items;
+    uint32_t item_count;
+    uint32_t item_limit;
+    char* path;
+    size_t path_limit;
+    // two extent buffers per compare worker, used when the images are not mapped.
+    uint8_t** buffs;
+    uint32_t unchanged;
+    uint32_t changed;
+    volatile uint64_t compared;
+} fat_diff_t;
+
 #define first_sector_of_cluster(fatfs, cluster) (((cluster)-2) * (fatfs)->bpb.BPB_SecPerClus + (fatfs)->first_data_sector)
+#define fat_clus_addr(fc, cluster) ((uint64_t)(first_sector_of_cluster(&(fc)->fatfs, cluster) + (fc)->device->part_start) * (fc)->device->sector_size)
+
+// get image bytes in place when the device is mapped, otherwise copy into buff.
+static const uint8_t* fat_ck_peek(fat_ck_t* fc, uint64_t offset, uint8_t* buff, size_t size)
+{
+    const uint8_t* data = NULL;
+    uint32_t low = 0;
+    uint32_t high = fc->run_count;
+    uint32_t middle = 0;
+
+    // staged sweep runs are sorted by address.
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        if (fc->runs[middle].addr <= offset)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    if ((low > 0) && ((offset + size) <= (fc->runs[low - 1].addr + fc->runs[low - 1].size)))
+    {
+        return fc->runs[low - 1].data + (offset - fc->runs[low - 1].addr);
+    }
+    FAT_STAT_ADD(fc, bytes_read, size);
+    FAT_STAT_ADD(fc, read_calls, 1);
+    data = fat_dev_map(fc->device, offset, size);
+    if (data != NULL)
+    {
+        return data;
+    }
+    if (fat_dev_read(fc->device, offset, buff, size) != size)
+    {
+        return NULL;
+    }
+    return buff;
+}
 
 static int fat_root_read(fat_ck_t* fc)
 {
@@ -241,13 +573,15 @@ static int fat_root_read(fat_ck_t* fc)
     fc->sector_buffer = (uint8_t*)calloc(1, fc->device->sector_size * sizeof(uint8_t));
     if (fc->sector_buffer == NULL)
     {
-        printf("fat check object sector buffer malloc failed.\r\n");
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat check object sector buffer malloc failed.");
         return result;
     }
     result = fat_dev_read(fc->device, 0, fc->sector_buffer, fc->device->sector_size);
+    FAT_STAT_ADD(fc, bytes_read, fc->device->sector_size);
+    FAT_STAT_ADD(fc, read_calls, 1);
     if (result != fc->device->sector_size)
     {
-        printf("fat root get dpt address failed.\r\n");
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat root get dpt address failed.");
         return result;
     }
     // get fat device start parttion.
@@ -260,10 +594,12 @@ static int fat_root_read(fat_ck_t* fc)
     {
         fc->device->part_start = FAT_GET_UINT32(&fc->sector_buffer[FAT_DPT_ADDRESS] + 8);
     }
-    result = fat_dev_read(fc->device, (fc->device->part_start * fc->device->sector_size), fc->sector_buffer, fc->device->sector_size);
+    result = fat_dev_read(fc->device, ((uint64_t)fc->device->part_start * fc->device->sector_size), fc->sector_buffer, fc->device->sector_size);
+    FAT_STAT_ADD(fc, bytes_read, fc->device->sector_size);
+    FAT_STAT_ADD(fc, read_calls, 1);
     if (result != fc->device->sector_size)
     {
-        printf("fat root read start parttion failed.\r\n");
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat root read start parttion failed.");
         return result;
     }
     // get fat device bpb sector.
@@ -286,7 +622,7 @@ static int fat_root_read(fat_ck_t* fc)
     bpb->BS_BootSign = FAT_GET_UINT16(&sec_bpb[BPB_BOOT_SIG]);
     if (bpb->BS_BootSign != 0xAA55) 
     {
-        printf("It's not a FAT file system.\r\n");
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "It's not a FAT file system.");
         return -1;
     }
 
@@ -297,7 +633,7 @@ static int fat_root_read(fat_ck_t* fc)
 
     if (bpb->BPB_BytsPerSec == 0)
     {
-        printf("The FAT file system is damaged, bpb->bpb_bytspersec is 0.\r\n");
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "The FAT file system is damaged, bpb->bpb_bytspersec is 0.");
         return -1;
     }
     /* the root dir sectors always zero for FAT32 */
@@ -306,7 +642,7 @@ static int fat_root_read(fat_ck_t* fc)
 
     if (bpb->BPB_SecPerClus == 0) 
     {
-        printf("The FAT file system is damaged, bpb->bpb_secperclus is 0.\r\n");
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "The FAT file system is damaged, bpb->bpb_secperclus is 0.");
         return -1;
     }
     /* determine FAT type */
@@ -334,7 +670,7 @@ static int fat_root_read(fat_ck_t* fc)
         /* load FAT 32 parameters */
         bpb->BPB_ExtFlags = FAT_GET_UINT16(&sec_bpb[BPB_EXTFLAGS]);
         bpb->BPB_FSVer = FAT_GET_UINT16(&sec_bpb[BPB_FSVER]);
-        bpb->BPB_RootClus = FAT_GET_UINT16(&sec_bpb[BPB_ROOTCLUS]);
+        bpb->BPB_RootClus = FAT_GET_UINT32(&sec_bpb[BPB_ROOTCLUS]);
         bpb->BPB_FSInfo = FAT_GET_UINT16(&sec_bpb[BPB_FSINFO]);
         bpb->BPB_BkBootSec = FAT_GET_UINT16(&sec_bpb[BPB_BKBOOTSEC]);
         bpb->BS_DrvNum = sec_bpb[BS_32_DRVNUM];
@@ -354,7 +690,9 @@ static int fat_root_read(fat_ck_t* fc)
         fatfs->root_dir_sector = first_sector_of_cluster(fatfs, bpb->BPB_RootClus);
 
         /* read file system info */
-        result = fat_dev_read(fc->device, ((fc->device->part_start + 1) * fc->device->sector_size), fc->sector_buffer, fc->device->sector_size);
+        result = fat_dev_read(fc->device, ((uint64_t)(fc->device->part_start + bpb->BPB_FSInfo) * fc->device->sector_size), fc->sector_buffer, fc->device->sector_size);
+        FAT_STAT_ADD(fc, bytes_read, fc->device->sector_size);
+        FAT_STAT_ADD(fc, read_calls, 1);
         if (result != fc->device->sector_size)
         {
             /* clean FAT filesystem entry */
@@ -362,13 +700,16 @@ static int fat_root_read(fat_ck_t* fc)
             return -1;
         }
 
+        /* the counters are checked against the FAT later */
+        fatfs->fsinfo_valid = (bpb->BPB_FSInfo != 0) &&
+            ((FAT_GET_UINT32(&sec_bpb[FAT_FSINFO_LEADSIG])) == 0x41615252) &&
+            ((FAT_GET_UINT32(&sec_bpb[FAT_FSINFO_STRUCSIG])) == 0x61417272) &&
+            (((FAT_GET_UINT32(&sec_bpb[FAT_FSINFO_TRAILSIG])) & 0xFFFF0000) == 0xAA550000);
         fatfs->free_count = FAT_GET_UINT32(&sec_bpb[FAT_FSINFO_FREECNT]);
         fatfs->next_free = FAT_GET_UINT32(&sec_bpb[FAT_FSINFO_NEXTFREE]);
-
-        /* calculate freecount if unset */
-        if (fatfs->free_count == 0xffffffff) 
+        if (!fatfs->fsinfo_valid)
         {
-            printf("free count is wrong.\r\n");
+            fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "fsinfo", "FSInfo sector %d signature is wrong.", bpb->BPB_FSInfo);
         }
     }
     else 
@@ -377,416 +718,3678 @@ static int fat_root_read(fat_ck_t* fc)
         fatfs->root_dir_sector = bpb->BPB_RsvdSecCnt + (bpb->BPB_NumFATs * bpb->BPB_FATSz16);
     }
 
-    printf("OEM %s.\r\n", fatfs->bpb.BS_OEMName);
-    printf("Bytes per sector %d.\r\n", fatfs->bpb.BPB_BytsPerSec);
-    printf("Sectors per cluster %d.\r\n", fatfs->bpb.BPB_SecPerClus);
-    printf("Number of reserved sector %d.\r\n", fatfs->bpb.BPB_RsvdSecCnt);
-    printf("Number of FAT table %d.\r\n", fatfs->bpb.BPB_NumFATs);
-    printf("Number of directories entry in root %d.\r\n", fatfs->bpb.BPB_RootEntCnt);
-    printf("Number of sectors per FAT %lu.\r\n", fatfs->fat_size);
-    printf("Number of sectors in root directory %d.\r\n", fatfs->root_dir_sectors);
-    printf("Total sectors %lu.\r\n", fatfs->total_sectors);
-    printf("Sector of root directory %lu.\r\n", fatfs->root_dir_sector);
-    printf("Number of data cluster %lu.\r\n", fatfs->data_clusters);
-    printf("The first data sector %lu.\r\n", fatfs->first_data_sector);
-    printf("FAT type: %d.\r\n", fatfs->fat_type);
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "bpb");
+    fat_rep_str(&fc->rep, "oem", "OEM %s.\r\n", (const char*)fatfs->bpb.BS_OEMName);
+    fat_rep_uint(&fc->rep, "bytes_per_sector", "Bytes per sector %llu.\r\n", fatfs->bpb.BPB_BytsPerSec);
+    fat_rep_uint(&fc->rep, "sectors_per_cluster", "Sectors per cluster %llu.\r\n", fatfs->bpb.BPB_SecPerClus);
+    fat_rep_uint(&fc->rep, "reserved_sectors", "Number of reserved sector %llu.\r\n", fatfs->bpb.BPB_RsvdSecCnt);
+    fat_rep_uint(&fc->rep, "fat_count", "Number of FAT table %llu.\r\n", fatfs->bpb.BPB_NumFATs);
+    fat_rep_uint(&fc->rep, "root_entries", "Number of directories entry in root %llu.\r\n", fatfs->bpb.BPB_RootEntCnt);
+    fat_rep_uint(&fc->rep, "fat_sectors", "Number of sectors per FAT %llu.\r\n", fatfs->fat_size);
+    fat_rep_uint(&fc->rep, "root_sectors", "Number of sectors in root directory %llu.\r\n", fatfs->root_dir_sectors);
+    fat_rep_uint(&fc->rep, "total_sectors", "Total sectors %llu.\r\n", fatfs->total_sectors);
+    fat_rep_uint(&fc->rep, "root_sector", "Sector of root directory %llu.\r\n", fatfs->root_dir_sector);
+    fat_rep_uint(&fc->rep, "data_clusters", "Number of data cluster %llu.\r\n", fatfs->data_clusters);
+    fat_rep_uint(&fc->rep, "first_data_sector", "The first data sector %llu.\r\n", fatfs->first_data_sector);
+    fat_rep_uint(&fc->rep, "fat_type", "FAT type: %llu.\r\n", fatfs->fat_type);
+    fat_rep_end(&fc->rep);
     return 0;
 }
 
-static int fat_fats_check(fat_ck_t* fc, uint32_t start, uint32_t end)
+static void fat_fats_hash(fat_ck_t* fc, uint64_t load_addr, const uint8_t* data, size_t size)
 {
-    int result = -1;
-    uint8_t  fat_info[FAT16_INFO_SIZE] = { 0x00 };
-    uint16_t value = 0;
-    uint16_t count = 0;
-    uint32_t index_addr = start + (2 * sizeof(fat_info));
-    uint32_t start_addr = 0;
-    
-    while (true)
+    uint32_t sector_size = fc->device->sector_size;
+    uint32_t index = 0;
+    size_t offset = 0;
+    size_t part = 0;
+
+    // one hash per FAT sector, compared with the last run.
+    for (offset = 0; offset < size; offset = offset + sector_size)
     {
-        // read finished, break loop.
-        if (index_addr >= end)
-        {
-            break;
-        }
-        result = fat_dev_read(fc->device, index_addr, fat_info, sizeof(fat_info));
-        if (result == sizeof(fat_info))
+        index = (uint32_t)((load_addr + offset) / sector_size);
+        part = ((size - offset) < sector_size) ? (size - offset) : sector_size;
+        fc->side_next->fat_hashes[index] = fat_hash64(data + offset, part, 0);
+        if ((fc->side->fat_count != fc->side_next->fat_count) || (fc->side->fat_hashes[index] != fc->side_next->fat_hashes[index]))
         {
-            value = FAT_GET_UINT16(&fat_info[0]);
-            if (FAT16_CLUS_FRE(value))
-            {
-                printf("Addr [0x%08X - 0x%08X]: %-4d Clusters Free.\r\n", index_addr, index_addr, 1);
-                break;
-            }
-            else if (FAT16_CLUS_RVD(value))
-            {
-                printf("Addr [0x%08X - 0x%08X]: %-4d Clusters Reserved.\r\n", index_addr, index_addr, 1);
-            }
-            else if (FAT16_CLUS_USE(value))
-            {
-                count = count + 1;
-                start_addr = (start_addr == 0) ? index_addr : start_addr;
-            }
-            else if (FAT16_CLUS_BAD(value))
-            {
-                printf("Addr [0x%08X - 0x%08X]: %-4d Clusters Bad.\r\n", index_addr, index_addr, 1);
-            }
-            else if (FAT16_CLUS_END(value))
-            {
-                count = (start_addr == 0) ? 1 : count + 1;
-                start_addr = (start_addr == 0) ? index_addr : start_addr;
-                printf("Addr [0x%08X - 0x%08X]: %-4d Clusters Use.\r\n", start_addr, index_addr, count);
-                start_addr = 0;
-                count = 0;
-            }
-            index_addr = index_addr + sizeof(fat_info);
+            fc->fat_changed = fc->fat_changed + 1;
         }
-        else
+    }
+}
+
+static void fat_fats_decode(uint8_t fat_type, const uint8_t* data, uint32_t base, uint32_t stop, uint32_t* table)
+{
+    uint32_t index = 0;
+    uint32_t value = 0;
+    uint32_t offset = 0;
+
+    // entries [base, stop) of one load block, the block starts on an entry boundary.
+    for (index = base; index < stop; index++)
+    {
+        offset = (uint32_t)(((uint64_t)(index - base) * FAT_ENTRY_BITS(fat_type)) / 8);
+        switch (fat_type)
         {
-            result = 0;
+        case FAT_TYPE_FAT12:
+            value = FAT_GET_UINT16(&data[offset]);
+            value = (index & 1) ? (value >> 4) : (value & 0x0FFF);
+            value = (value >= 0x0FF7) ? (value | 0x0FFFF000) : value;
+            break;
+        case FAT_TYPE_FAT16:
+            value = FAT_GET_UINT16(&data[offset]);
+            value = (value >= 0xFFF7) ? (value | 0x0FFF0000) : value;
+            break;
+        default:
+            value = FAT_GET_UINT32(&data[offset]);
+            value = value & 0x0FFFFFFF;
             break;
         }
+        table[index - base] = value;
     }
-    return result;
 }
 
-static int fat_fats_count(fat_ck_t* fc, uint32_t index)
+static const uint8_t* fat_fats_read(fat_ck_t* fc, uint32_t window, uint32_t* table, uint64_t* size)
 {
-    int result = -1;
-    uint8_t  fat_info[FAT16_INFO_SIZE] = { 0x00 };
-    uint32_t fat_addr = (fc->fatfs.fats_sector_start * fc->device->sector_size) + (index * sizeof(fat_info));
-    uint16_t value = 0;
-    uint16_t count = 0;
+    const uint8_t* data = NULL;
+    uint8_t  fat_type = fc->fatfs.fat_type;
+    uint64_t fats_addr = (uint64_t)fc->fatfs.fats_sector_start * fc->device->sector_size;
+    uint64_t fats_size = ((uint64_t)fc->fat_entries * FAT_ENTRY_BITS(fat_type) + 7) / 8;
+    uint64_t load_addr = (uint64_t)window * FAT_LOAD_SIZE;
+    uint32_t base = window * fc->win.entries;
+    uint32_t stop = ((fc->fat_entries - base) < fc->win.entries) ? fc->fat_entries : (base + fc->win.entries);
 
-    while (true)
+    // one window is one load block of the first FAT.
+    *size = ((fats_size - load_addr) < FAT_LOAD_SIZE) ? (fats_size - load_addr) : FAT_LOAD_SIZE;
+    data = fat_ck_peek(fc, fats_addr + load_addr, fc->win.raw, (size_t)*size);
+    if (data != NULL)
+    {
+        fat_fats_decode(fat_type, data, base, stop, table);
+    }
+    return data;
+}
+
+static const fat_win_run_t* fat_win_find(const fat_win_t* win, uint32_t index)
+{
+    uint32_t low = 0;
+    uint32_t high = win->run_count;
+    uint32_t middle = 0;
+
+    // the runs cover every entry, the last one starting at or before index holds it.
+    while (low < high)
     {
-        result = fat_dev_read(fc->device, fat_addr, fat_info, sizeof(fat_info));
-        if (result == sizeof(fat_info))
+        middle = (low + high) / 2;
+        if (win->runs[middle].first <= index)
         {
-            value = FAT_GET_UINT16(&fat_info[0]);
-            if (FAT16_CLUS_FRE(value))
-            {
-                count = 0;
-                break;
-            }
-            else if (FAT16_CLUS_RVD(value))
-            {
-                count = 0;
-                break;
-            }
-            else if (FAT16_CLUS_USE(value))
-            {
-                count = count + 1;
-            }
-            else if (FAT16_CLUS_BAD(value))
-            {
-                fat_addr = fat_addr + sizeof(fat_info);
-                continue;
-            }
-            else if (FAT16_CLUS_END(value))
-            {
-                count = count + 1;
-                break;
-            }
-            fat_addr = fat_addr + sizeof(fat_info);
+            low = middle + 1;
         }
         else
         {
-            return count;
+            high = middle;
         }
     }
-    return count;
+    return &win->runs[low - 1];
 }
 
-static int fat_lfn_read(fat_ck_t* fc, uint32_t start, uint32_t count, uint8_t *name, size_t size)
+static int fat_win_page(fat_ck_t* fc)
 {
-    int result = -1;
-    uint8_t dir_info[FAT_DIR_ENTRY_SIZE] = { 0x00 };
-    uint32_t sfn_addr = start;
-    int index = 0, i = 0, j = 0;
-    // read long name info.
-    for (index = 1; index < count + 1; index++)
-    {
-        result = fat_dev_read(fc->device, (sfn_addr - (sizeof(dir_info) * index)), dir_info, sizeof(dir_info));
-        if ((result == sizeof(dir_info)) && (dir_info[0] != '\0'))
-        {
-            // long file name field 1
-            for (i = FAT_LFN_1_START; (i <= FAT_LFN_1_END) && (j < size); i = i + 2, j = j + 1)
-            {
-                if (dir_info[i] != 0xFF)
-                {
-                    name[j] = dir_info[i];
-                }
-            }
-            // long file name field 2
-            for (i = FAT_LFN_2_START; (i <= FAT_LFN_2_END) && (j < size); i = i + 2, j = j + 1)
-            {
-                if (dir_info[i] != 0xFF)
-                {
-                    name[j] = dir_info[i];
-                }
-            }
-            // long file name field 3
-            for (i = FAT_LFN_3_START; (i <= FAT_LFN_3_END) && (j < size); i = i + 2, j = j + 1)
-            {
-                if (dir_info[i] != 0xFF)
-                {
-                    name[j] = dir_info[i];
-                }
-            }
-        }
-    }
-    // set name end.
-    if (j + 1 < size)
-    {
-        name[j + 1] = '\0';
-    }
-    else
+    fat_win_t* win = &fc->win;
+
+    // the run index outgrew the cap, its budget holds small decoded pages instead, a miss reads one page back.
+    free(win->runs);
+    win->runs = NULL;
+    win->run_count = 0;
+    win->run_limit = 0;
+    win->mode = FAT_WIN_PAGED;
+    win->slot_count = (uint32_t)(win->run_budget / (FAT_WIN_PAGE * sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t)));
+    win->slot_ways = (win->slot_count < FAT_WIN_WAYS) ? win->slot_count : FAT_WIN_WAYS;
+    win->slot_count = win->slot_count - (win->slot_count % win->slot_ways);
+    win->slots = (uint32_t*)malloc((size_t)win->slot_count * FAT_WIN_PAGE * sizeof(uint32_t));
+    win->slot_page = (uint32_t*)malloc(win->slot_count * sizeof(uint32_t));
+    win->slot_used = (uint64_t*)calloc(win->slot_count, sizeof(uint64_t));
+    if ((win->slots == NULL) || (win->slot_page == NULL) || (win->slot_used == NULL))
     {
-        name[size - 1] = '\0';
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat window slots malloc failed.");
+        return -1;
     }
+    memset(win->slot_page, 0xFF, win->slot_count * sizeof(uint32_t));
     return 0;
 }
 
-static int fat_sfn_read(char name[FAT_SFN_SIZE], uint8_t attr)
+static int fat_win_index(fat_ck_t* fc, uint32_t base, uint32_t stop, const uint32_t* table)
 {
-    size_t index = 0;
-    size_t useds = 0;
-    size_t start = 0;
-    size_t limit = 0;
-    size_t point = 0;
-    char temp[FAT_SFN_SIZE] = { 0 };
+    fat_win_t* win = &fc->win;
+    fat_win_run_t* run = (win->run_count > 0) ? &win->runs[win->run_count - 1] : NULL;
+    fat_win_run_t* runs = NULL;
+    uint64_t limit = 0;
+    uint32_t index = 0;
+    uint32_t value = 0;
 
-    switch (attr)
-    {
-    case SFN_BODY_LOW_CASE:
-        start = FAT_SFN_BODY_START; limit = FAT_SFN_BODY_END;
-        break;
-    case SFN_EXTE_LOW_CASE:
-        start = FAT_SFN_EXTE_START; limit = FAT_SFN_EXTE_END;
-        break;
-    case SFN_ALLS_LOW_CASE:
-        start = FAT_SFN_BODY_START; limit = FAT_SFN_EXTE_END;
-        break;
-    default:
-        start = FAT_SFN_BODY_START; limit = FAT_SFN_BODY_START;
-        break;
-    }
-    memset(temp, 0, FAT_SFN_SIZE);
-    // uper char transfer to lower char.
-    for (index = 0; ((index < FAT_SFN_SIZE) && (useds < FAT_SFN_SIZE)); index++)
+    for (index = base; index < stop; index++)
     {
-        if ((index >= start) && (index <= limit) && (name[index] >= 'A') && (name[index] <= 'Z'))
+        value = table[index - base];
+        // a run goes on while its tail links to the next entry, or while every entry holds one value.
+        if ((run != NULL) && !(run->count & FAT_WIN_FILL) && (run->tail == index))
         {
-            name[index] = tolower(name[index]);
+            run->count = run->count + 1;
+            run->tail = value;
+            continue;
         }
-        if (name[index] > ' ')
+        if ((run != NULL) && ((run->count & FAT_WIN_FILL) || (run->count == 1)) && (run->tail == value))
         {
-            temp[useds] = name[index];
-            useds = useds + 1;
+            run->count = (run->count + 1) | FAT_WIN_FILL;
+            continue;
         }
-        if (index == FAT_SFN_BODY_END)
+        if (win->run_count >= win->run_limit)
         {
-            point = useds;
-            temp[useds] = '.';
-            useds = useds + 1;
+            limit = (win->run_limit == 0) ? 0x1000 : ((uint64_t)win->run_limit * 2);
+            limit = (limit < win->run_budget / sizeof(fat_win_run_t)) ? limit : (win->run_budget / sizeof(fat_win_run_t));
+            if (limit <= win->run_count)
+            {
+                return fat_win_page(fc);
+            }
+            runs = (fat_win_run_t*)realloc(win->runs, (size_t)limit * sizeof(fat_win_run_t));
+            if (runs == NULL)
+            {
+                fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat run index malloc failed.");
+                return -1;
+            }
+            win->runs = runs;
+            win->run_limit = (uint32_t)limit;
         }
+        run = &win->runs[win->run_count];
+        run->first = index;
+        run->count = 1;
+        run->tail = value;
+        win->run_count = win->run_count + 1;
     }
-    if (useds < FAT_SFN_SIZE)
+    return 0;
+}
+
+// decoded page of a paged FAT, a miss reads the page alone into the least recently used slot of its set. called with the window lock held.
+static const uint32_t* fat_win_slot(fat_ck_t* fc, uint32_t page)
+{
+    fat_win_t* win = &fc->win;
+    uint8_t  fat_type = fc->fatfs.fat_type;
+    uint64_t fats_addr = (uint64_t)fc->fatfs.fats_sector_start * fc->device->sector_size;
+    uint32_t first = (page % (win->slot_count / win->slot_ways)) * win->slot_ways;
+    uint32_t slot = first;
+    uint32_t index = 0;
+    uint32_t base = page * FAT_WIN_PAGE;
+    uint32_t stop = ((fc->fat_entries - base) < FAT_WIN_PAGE) ? fc->fat_entries : (base + FAT_WIN_PAGE);
+    uint64_t load_addr = ((uint64_t)base * FAT_ENTRY_BITS(fat_type)) / 8;
+    uint64_t load_size = (((uint64_t)stop * FAT_ENTRY_BITS(fat_type) + 7) / 8) - load_addr;
+    uint32_t* table = NULL;
+    const uint8_t* data = NULL;
+
+    win->tick = win->tick + 1;
+    for (index = first; index < first + win->slot_ways; index++)
     {
-        if ((point > 0) && (point == (useds - 1)))
-        {
-            temp[point] = '\0';
-        }
-        else
+        if (win->slot_page[index] == page)
         {
-            temp[useds] = '\0';
+            win->slot_used[index] = win->tick;
+            return win->slots + (size_t)index * FAT_WIN_PAGE;
         }
+        slot = (win->slot_used[index] < win->slot_used[slot]) ? index : slot;
     }
-    else
+    table = win->slots + (size_t)slot * FAT_WIN_PAGE;
+    win->slot_page[slot] = FAT_WIN_EMPTY;
+    win->slot_used[slot] = 0;
+    data = fat_ck_peek(fc, fats_addr + load_addr, win->raw, (size_t)load_size);
+    if (data == NULL)
     {
-        temp[FAT_SFN_SIZE - 1] = '\0';
+        return NULL;
     }
-    memcpy(name, temp, FAT_SFN_SIZE);
-    return 0;
+    fat_fats_decode(fat_type, data, base, stop, table);
+    win->slot_page[slot] = page;
+    win->slot_used[slot] = win->tick;
+    win->loads = win->loads + 1;
+    return table;
 }
 
-static int fat_dirs_check(fat_ck_t* fc, uint32_t start, uint32_t end)
+// next cluster of a FAT entry, a window that can not be read again reads as a bad cluster.
+static uint32_t fat_link(fat_ck_t* fc, uint32_t index)
 {
-    int result = -1;
-    uint8_t dir_info[FAT_DIR_ENTRY_SIZE] = { 0x00 };
-    fat_dir_t dir = { 0 };
-    uint8_t lfn_cnt = 0;
-    uint8_t lfn_buf[FAT_LFN_SIZE] = { 0x00 };
-    
-    while (true)
+    fat_win_t* win = &fc->win;
+    const fat_win_run_t* run = NULL;
+    const uint32_t* table = NULL;
+    uint32_t value = 0;
+
+    if (fc->fat_table != NULL)
     {
-        // read finished, break loop.
-        if (start >= end)
-        {
-            break;
-        }
-        result = fat_dev_read(fc->device, start, dir_info, sizeof(dir_info));
-        if ((result == sizeof(dir_info)) && (dir_info[0] != '\0'))
+        return fc->fat_table[index];
+    }
+    if (win->mode == FAT_WIN_RUNS)
+    {
+        run = fat_win_find(win, index);
+        return ((run->count & FAT_WIN_FILL) || (index + 1 == run->first + run->count)) ? run->tail : (index + 1);
+    }
+    fat_mutex_lock(&win->lock);
+    table = fat_win_slot(fc, index / FAT_WIN_PAGE);
+    value = (table != NULL) ? table[index % FAT_WIN_PAGE] : 0x0FFFFFF7;
+    fat_mutex_unlock(&win->lock);
+    return value;
+}
+
+// length of the extent of clusters linked one after the other from index, and the link of its last cluster.
+static uint32_t fat_link_run(fat_ck_t* fc, uint32_t index, uint32_t* tail)
+{
+    fat_win_t* win = &fc->win;
+    const fat_win_run_t* run = NULL;
+    const uint32_t* table = NULL;
+    uint32_t first = index;
+    uint32_t base = 0;
+    uint32_t stop = 0;
+
+    if (fc->fat_table != NULL)
+    {
+        stop = fat_simd_run(fc->fat_table, index, fc->fat_entries);
+        *tail = fc->fat_table[index + stop - 1];
+        return stop;
+    }
+    if (win->mode == FAT_WIN_RUNS)
+    {
+        // a linked run ends on its tail, a fill run links on at most once, the next run starts where either leaves.
+        for (run = fat_win_find(win, index); true; run++)
         {
-            // this is "." or ".." dir
-            if (IS_CURRENT_DIR(dir_info) || IS_PARENTS_DIR(dir_info))
+            stop = run->first + (run->count & ~FAT_WIN_FILL);
+            if (!(run->count & FAT_WIN_FILL))
             {
-                start = start + sizeof(dir_info);
-                continue;
-            }
-            // this is short file name or other files.
-            if (dir_info[DIR_ATTR] == ATTR_READ_ONLY || \
-                dir_info[DIR_ATTR] == ATTR_HIDDEN    || \
-                dir_info[DIR_ATTR] == ATTR_SYSTEM    || \
-                dir_info[DIR_ATTR] == ATTR_VOLUME_ID || \
-                dir_info[DIR_ATTR] == ATTR_DIRECTORY || \
-                dir_info[DIR_ATTR] == ATTR_ARCHIVE)
-            {
-                memset(&dir, 0, sizeof(fat_dir_t));
-                strncpy(dir.DIR_Name, dir_info, FAT_SFN_SIZE - 2);
-                dir.DIR_Attr = dir_info[DIR_ATTR];
-                dir.DIR_NTRes = dir_info[DIR_NTRES];
-                dir.DIR_CrtTimeTenth = dir_info[DIR_CRT_TIME_TENTH];
-                dir.DIR_CrtTime = FAT_GET_UINT16(&dir_info[DIR_CRT_TIME]);
-                dir.DIR_CrtDate = FAT_GET_UINT16(&dir_info[DIR_CRT_DATE]);
-                dir.DIR_LstAccDate = FAT_GET_UINT16(&dir_info[DIR_LST_ACC_DATE]);
-                dir.DIR_FstClusHI = FAT_GET_UINT16(&dir_info[DIR_FST_CLUS_HI]);
-                dir.DIR_WrtTime = FAT_GET_UINT16(&dir_info[DIR_WRT_TIME]);
-                dir.DIR_WrtDate = FAT_GET_UINT16(&dir_info[DIR_WRT_DATE]);
-                dir.DIR_FstClusLO = FAT_GET_UINT16(&dir_info[DIR_FST_CLUS_LO]);
-                dir.DIR_FileSize = FAT_GET_UINT32(&dir_info[DIR_FILE_SIZE]);
-                // long file name
-                if (lfn_cnt > 0)
-                {
-                    fat_lfn_read(fc, start, lfn_cnt, &lfn_buf, FAT_LFN_SIZE);
-                    printf("\r\nDIR_Name         : %s \r\n", lfn_buf);
-                    lfn_cnt = 0;
-                }
-                // short file name.
-                else
-                {
-                    fat_sfn_read(dir.DIR_Name, dir.DIR_NTRes);
-                    printf("\r\nDIR_Name         : %s \r\n", dir.DIR_Name);
-                }
-                // other file attr.
-                printf("DIR_Attr         : 0x%02X \r\n", dir.DIR_Attr);
-                printf("DIR_NTRes        : 0x%02X \r\n", dir.DIR_NTRes);
-                printf("DIR_CrtTimeTenth : %d \r\n", dir.DIR_CrtTimeTenth);
-                printf("DIR_CrtTime      : %d \r\n", dir.DIR_CrtTime);
-                printf("DIR_CrtDate      : %d \r\n", dir.DIR_CrtDate);
-                printf("DIR_LstAccDate   : %d \r\n", dir.DIR_LstAccDate);
-                printf("DIR_FstClusHI    : %d \r\n", dir.DIR_FstClusHI);
-                printf("DIR_WrtTime      : %d \r\n", dir.DIR_WrtTime);
-                printf("DIR_WrtDate      : %d \r\n", dir.DIR_WrtDate);
-                printf("DIR_FstClusLO    : %d \r\n", dir.DIR_FstClusLO);
-                printf("DIR_FileSize     : %d \r\n", dir.DIR_FileSize);
-                // this is subdirectory.
-                if ((dir.DIR_FstClusLO > 0) && (dir.DIR_FileSize == 0))
-                {
-                    uint16_t count = fat_fats_count(fc, dir.DIR_FstClusLO);
-                    uint32_t addrs = (fc->fatfs.root_sector_start + 2 + dir.DIR_FstClusLO) * fc->device->sector_size;
-                    uint32_t stops = addrs + count * fc->device->sector_size;
-                    fat_dirs_check(fc, addrs, stops);
-                }
+                index = stop - 1;
             }
-            // this is long file name.
-            else if (dir_info[DIR_ATTR] == ATTR_LONG_FILE_NAME)
+            else if ((run->tail == index + 1) && (index + 1 < stop))
             {
-                //printf("Long file name info.\r\n");
-                lfn_cnt = lfn_cnt + 1;
+                index = index + 1;
             }
-            else
+            *tail = run->tail;
+            if ((*tail != index + 1) || (*tail >= fc->fat_entries))
             {
-                //printf("Unknown file name info.\r\n");
                 break;
             }
-            // read next info.
-            start = start + sizeof(dir_info);
+            index = index + 1;
         }
-        else
+        return index - first + 1;
+    }
+    fat_mutex_lock(&win->lock);
+    while (true)
+    {
+        base = index - (index % FAT_WIN_PAGE);
+        stop = ((fc->fat_entries - base) < FAT_WIN_PAGE) ? fc->fat_entries : (base + FAT_WIN_PAGE);
+        table = fat_win_slot(fc, index / FAT_WIN_PAGE);
+        if (table == NULL)
+        {
+            *tail = 0x0FFFFFF7;
+            break;
+        }
+        for (; (index + 1 < stop) && (table[index - base] == index + 1); index++);
+        *tail = table[index - base];
+        // the extent reaches the page end, it goes on in the next page.
+        if ((index + 1 != stop) || (*tail != stop) || (stop >= fc->fat_entries))
         {
-            result = 0;
             break;
         }
+        index = stop;
     }
-    return result;
+    fat_mutex_unlock(&win->lock);
+    return index - first + 1;
 }
 
-static int fat_root_check(fat_ck_t* fc)
+// entries [base, stop) of one window for a scan over the whole FAT, rebuilt when the table is not kept.
+static const uint32_t* fat_win_scan(fat_ck_t* fc, uint32_t base, uint32_t stop)
 {
-    int result = -1;
-    uint32_t BPB_FATSzxxx = 0;
-    uint32_t BPB_TotSecxx = 0;
-    fat_bpb_t* bpb = &fc->fatfs.bpb;
-
-    BPB_FATSzxxx = (fc->fatfs.fat_type == FAT_TYPE_FAT32) ? bpb->BPB_FATSz32 : bpb->BPB_FATSz16;
-    BPB_TotSecxx = (fc->fatfs.fat_type == FAT_TYPE_FAT32) ? bpb->BPB_TotSec32 : bpb->BPB_TotSec16;
-
-    fc->fatfs.fats_sector_start = fc->device->part_start + bpb->BPB_RsvdSecCnt;
-    fc->fatfs.fats_sector_count = BPB_FATSzxxx * bpb->BPB_NumFATs;
-    fc->fatfs.root_sector_start = fc->fatfs.fats_sector_start + fc->fatfs.fats_sector_count;
-    fc->fatfs.root_sector_count = (32 * bpb->BPB_RootEntCnt + bpb->BPB_BytsPerSec - 1) / bpb->BPB_BytsPerSec;
-    fc->fatfs.data_sector_start = fc->fatfs.root_sector_start + fc->fatfs.root_sector_count;
-    fc->fatfs.data_sector_count = BPB_TotSecxx - fc->fatfs.data_sector_start;
-
-    printf("\r\n");
-    printf("fats_sector_start %d.\r\n", fc->fatfs.fats_sector_start);
-    printf("fats_sector_count %d.\r\n", fc->fatfs.fats_sector_count);
-    printf("root_sector_start %d.\r\n", fc->fatfs.root_sector_start);
-    printf("root_sector_count %d.\r\n", fc->fatfs.root_sector_count);
-    printf("data_sector_start %d.\r\n", fc->fatfs.data_sector_start);
-    printf("data_sector_count %d.\r\n", fc->fatfs.data_sector_count);
-    
-    // process fat table
-    uint32_t fats_start = (fc->fatfs.fats_sector_start * fc->device->sector_size);
-    uint32_t fats_end = (fc->fatfs.fats_sector_start + fc->fatfs.fats_sector_count) * fc->device->sector_size;
-    fat_fats_check(fc, fats_start, fats_end);
-
-    // process fat root directory
-    uint32_t root_start = (fc->fatfs.root_sector_start * fc->device->sector_size);
-    uint32_t root_end = (fc->fatfs.root_sector_start + fc->fatfs.root_sector_count) * fc->device->sector_size;
-    fat_dirs_check(fc, root_start, root_end);
+    fat_win_t* win = &fc->win;
+    const fat_win_run_t* run = NULL;
+    const uint8_t* data = NULL;
+    uint32_t index = 0;
+    uint64_t size = 0;
 
-    // process fat data
-
-    return 0;
-}
-
-int fatck(const char* path, int sector_size)
-{
-    int result = -1;
-    fat_ck_t *fc = (fat_ck_t*)calloc(1, sizeof(fat_ck_t));
-    if (fc == NULL)
-    {
-        printf("fat check object create failed.\r\n");
-        return result;
-    }
-    fc->device = fat_dev_open(path, sector_size);
-    if (fc->device == NULL)
+    if (fc->fat_table != NULL)
     {
-        printf("fat device object open failed.\r\n");
-        return result;
+        return fc->fat_table + base;
     }
-    result = fat_root_read(fc);
-    if (result < 0)
+    win->passes = win->passes + ((base == 0) ? 1 : 0);
+    if (win->mode == FAT_WIN_RUNS)
     {
-        printf("fat device root read failed.\r\n");
+        run = fat_win_find(win, base);
+        for (index = base; index < stop; index++)
+        {
+            if (index >= run->first + (run->count & ~FAT_WIN_FILL))
+            {
+                run = run + 1;
+            }
+            win->buff[index - base] = ((run->count & FAT_WIN_FILL) || (index + 1 == run->first + run->count)) ? run->tail : (index + 1);
+        }
+        return win->buff;
     }
-    result = fat_root_check(fc);
-    if (result < 0)
+    fat_mutex_lock(&win->lock);
+    data = fat_fats_read(fc, base / win->entries, win->buff, &size);
+    fat_mutex_unlock(&win->lock);
+    if (data == NULL)
     {
-        printf("fat device root check failed.\r\n");
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat window %u read failed.", base / win->entries);
+        return NULL;
     }
+    return win->buff;
+}
+
+static int fat_win_plan(fat_ck_t* fc)
+{
+    fat_win_t* win = &fc->win;
+    uint64_t window = 0;
+    uint64_t fixed = 0;
+    uint64_t least = 0;
+
+    win->entries = FAT_WIN_ENTRIES(fc->fatfs.fat_type);
+    window = (uint64_t)win->entries * sizeof(uint32_t);
+    win->state_bytes = ((uint64_t)fc->fat_entries + 3) / 4;
+    win->work_bytes = FAT_LOAD_SIZE + win->entries / 8;
+    win->full_bytes = (uint64_t)fc->fat_entries * sizeof(uint32_t) + win->state_bytes + win->work_bytes;
+    win->raw = (uint8_t*)malloc(FAT_LOAD_SIZE);
+    win->free_bits = (uint8_t*)malloc(win->entries / 8);
+    if ((win->raw == NULL) || (win->free_bits == NULL))
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat table malloc failed.");
+        return -1;
+    }
+    // the whole table when it fits the cap.
+    if ((win->cap == 0) || (win->full_bytes <= win->cap))
+    {
+        win->mode = FAT_WIN_FULL;
+        win->used_bytes = win->full_bytes;
+        fc->fat_table = (uint32_t*)malloc(fc->fat_entries * sizeof(uint32_t));
+        if (fc->fat_table == NULL)
+        {
+            fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat table malloc failed.");
+            return -1;
+        }
+        return 0;
+    }
+    // repairs rewrite entries in place, the table has to be resident.
+    if (fc->fix != NULL)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat repair needs the whole FAT table of %llu bytes, the cap is %llu.",
+            (unsigned long long)win->full_bytes, (unsigned long long)win->cap);
+        return -1;
+    }
+    // the state map, the scan window, its load block and free bitmap are always kept, then runs or decoded pages fill the rest.
+    fixed = win->state_bytes + window + win->work_bytes;
+    least = window + win->work_bytes + window * FAT_WIN_SLOTS_MIN;
+    // a state map the cap can not hold is spilled, 2^28 clusters take 64 MB of state alone.
+    if ((win->cap < fixed + window * FAT_WIN_SLOTS_MIN) && (win->cap >= least))
+    {
+        win->state_spill = true;
+        fixed = fixed - win->state_bytes;
+    }
+    win->fixed_bytes = fixed;
+    if (win->cap < fixed + window * FAT_WIN_SLOTS_MIN)
+    {
+        least = (win->full_bytes < least) ? win->full_bytes : least;
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat memory cap %llu is too small, at least %llu bytes are needed.",
+            (unsigned long long)win->cap, (unsigned long long)least);
+        return -1;
+    }
+    win->mode = FAT_WIN_RUNS;
+    win->run_budget = win->cap - fixed;
+    win->buff = (uint32_t*)malloc((size_t)window);
+    if (win->buff == NULL)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat window malloc failed.");
+        return -1;
+    }
+    return 0;
+}
+
+static int fat_fats_window(fat_ck_t* fc, uint32_t base, uint32_t stop, const uint32_t* table)
+{
+    fat_win_t* win = &fc->win;
+    uint32_t start = (base < 2) ? 2 : base;
+    uint32_t free = fc->clus_stat.free;
+    uint32_t index = 0;
+
+    // classify the data cluster entries in bulk, the free bitmap covers one window.
+    memset(win->free_bits, 0, win->entries / 8);
+    fat_simd_classify(table, start - base, stop - base, &fc->clus_stat, win->free_bits);
+    if ((fc->free_first == FAT_FSINFO_UNKNOWN) && (fc->clus_stat.free > free))
+    {
+        for (index = start - base; !FAT_BIT_GET(win->free_bits, index); index++);
+        fc->free_first = base + index;
+    }
+    return (win->mode == FAT_WIN_RUNS) ? fat_win_index(fc, base, stop, table) : 0;
+}
+
+static int fat_fats_load(fat_ck_t* fc)
+{
+    const uint8_t* load_data = NULL;
+    uint32_t* table = NULL;
+    uint8_t  fat_type = fc->fatfs.fat_type;
+    uint64_t fats_addr = (uint64_t)fc->fatfs.fats_sector_start * fc->device->sector_size;
+    uint64_t fats_size = (uint64_t)fc->fatfs.fat_size * fc->device->sector_size;
+    uint64_t load_size = 0;
+    uint32_t window = 0;
+    uint32_t base = 0;
+    uint32_t stop = 0;
+
+    // entries used by data clusters, never more than the FAT can hold.
+    fc->fat_entries = fc->fatfs.data_clusters + 2;
+    if (fc->fat_entries > (fats_size * 8) / FAT_ENTRY_BITS(fat_type))
+    {
+        fc->fat_entries = (uint32_t)((fats_size * 8) / FAT_ENTRY_BITS(fat_type));
+    }
+    if (fc->fat_entries <= 2)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat table is empty.");
+        return -1;
+    }
+    fats_size = ((uint64_t)fc->fat_entries * FAT_ENTRY_BITS(fat_type) + 7) / 8;
+    if (fat_win_plan(fc) < 0)
+    {
+        return -1;
+    }
+    if (fc->side_next != NULL)
+    {
+        fc->side_next->fat_count = (uint32_t)((fats_size + fc->device->sector_size - 1) / fc->device->sector_size);
+        fc->side_next->fat_hashes = (uint64_t*)calloc(fc->side_next->fat_count, sizeof(uint64_t));
+        if (fc->side_next->fat_hashes == NULL)
+        {
+            fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat table malloc failed.");
+            return -1;
+        }
+    }
+    memset(&fc->clus_stat, 0, sizeof(fat_clus_stat_t));
+    fc->free_first = FAT_FSINFO_UNKNOWN;
+    // read the first FAT in large blocks, decode every entry once and classify it while the block is hot.
+    for (base = 0; base < fc->fat_entries; base = stop)
+    {
+        stop = ((fc->fat_entries - base) < fc->win.entries) ? fc->fat_entries : (base + fc->win.entries);
+        table = (fc->fat_table != NULL) ? (fc->fat_table + base) : fc->win.buff;
+        load_data = fat_fats_read(fc, window, table, &load_size);
+        if (load_data == NULL)
+        {
+            fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat table read at 0x%08llX failed.", (unsigned long long)(fats_addr + (uint64_t)window * FAT_LOAD_SIZE));
+            return -1;
+        }
+        if (fc->side_next != NULL)
+        {
+            fat_fats_hash(fc, (uint64_t)window * FAT_LOAD_SIZE, load_data, (size_t)load_size);
+        }
+        if (fat_fats_window(fc, base, stop, table) < 0)
+        {
+            return -1;
+        }
+        window = window + 1;
+    }
+    FAT_STAT_ADD(fc, fat_entries, fc->fat_entries);
+    return 0;
+}
+
+static int fat_fats_raw(fat_ck_t* fc, uint64_t fat_addr, uint32_t index, uint32_t* value)
+{
+    uint8_t buff[4] = { 0x00 };
+    const uint8_t* data = NULL;
+    uint8_t fat_type = fc->fatfs.fat_type;
+    uint64_t offset = ((uint64_t)index * FAT_ENTRY_BITS(fat_type)) / 8;
+
+    // undecoded entry value as stored in one FAT copy.
+    data = fat_ck_peek(fc, fat_addr + offset, buff, (fat_type == FAT_TYPE_FAT32) ? 4 : 2);
+    if (data == NULL)
+    {
+        return -1;
+    }
+    switch (fat_type)
+    {
+    case FAT_TYPE_FAT12:
+        *value = FAT_GET_UINT16(data);
+        *value = (index & 1) ? (*value >> 4) : (*value & 0x0FFF);
+        break;
+    case FAT_TYPE_FAT16:
+        *value = FAT_GET_UINT16(data);
+        break;
+    default:
+        *value = FAT_GET_UINT32(data);
+        break;
+    }
+    return 0;
+}
+
+static int fat_repair_raw(fat_ck_t* fc, uint64_t fat_addr, uint32_t index, uint32_t value, uint32_t mask)
+{
+    uint8_t buff[4] = { 0x00 };
+    uint8_t fat_type = fc->fatfs.fat_type;
+    uint64_t offset = fat_addr + ((uint64_t)index * FAT_ENTRY_BITS(fat_type)) / 8;
+    size_t size = (fat_type == FAT_TYPE_FAT32) ? 4 : 2;
+    uint32_t raw = 0;
+
+    // read through the pending patches, FAT12 entries share a byte.
+    if (fat_fix_peek(fc->fix, offset, buff, size) != (int)size)
+    {
+        return -1;
+    }
+    raw = (fat_type == FAT_TYPE_FAT32) ? (FAT_GET_UINT32(buff)) : (uint32_t)FAT_GET_UINT16(buff);
+    if (fat_type == FAT_TYPE_FAT12)
+    {
+        mask = (index & 1) ? ((mask & 0x0FFF) << 4) : (mask & 0x0FFF);
+        value = (index & 1) ? (value << 4) : value;
+    }
+    raw = (raw & ~mask) | (value & mask);
+    buff[0] = (uint8_t)raw;
+    buff[1] = (uint8_t)(raw >> 8);
+    buff[2] = (uint8_t)(raw >> 16);
+    buff[3] = (uint8_t)(raw >> 24);
+    return fat_fix_patch(fc->fix, offset, buff, size);
+}
+
+static int fat_repair_entry(fat_ck_t* fc, uint32_t index, uint32_t value)
+{
+    uint8_t  fat_type = fc->fatfs.fat_type;
+    uint64_t fats_addr = (uint64_t)fc->fatfs.fats_sector_start * fc->device->sector_size;
+    uint64_t fat_bytes = (uint64_t)fc->fatfs.fat_size * fc->device->sector_size;
+    uint32_t mask = (fat_type == FAT_TYPE_FAT32) ? 0x0FFFFFFF : ((fat_type == FAT_TYPE_FAT16) ? 0xFFFF : 0x0FFF);
+    uint32_t copy = 0;
+
+    // every FAT copy gets the same value, FAT32 keeps its reserved top bits.
+    for (copy = 0; copy < fc->fatfs.bpb.BPB_NumFATs; copy++)
+    {
+        if (fat_repair_raw(fc, fats_addr + fat_bytes * copy, index, value & mask, mask) < 0)
+        {
+            fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat repair of entry %u failed.", index);
+            return -1;
+        }
+    }
+    fc->fat_table[index] = value;
+    return 0;
+}
+
+static const uint8_t* fat_fats_block(fat_ck_t* fc, uint64_t offset, uint8_t* buff, size_t size)
+{
+    const uint8_t* data = fat_dev_map(fc->device, offset, size);
+    FAT_STAT_ADD(fc, bytes_read, size);
+    FAT_STAT_ADD(fc, read_calls, 1);
+    // large blocks bypass the block cache.
+    if ((data == NULL) && (fat_dev_pread(fc->device, offset, buff, size) == (int)size))
+    {
+        data = buff;
+    }
+    return data;
+}
+
+static int fat_fats_fsinfo(fat_ck_t* fc)
+{
+    fat_fs_t* fatfs = &fc->fatfs;
+    uint32_t free_count = fc->clus_stat.free;
+    uint32_t next_free = fc->free_first;
+
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "free");
+    fat_rep_uint(&fc->rep, "free_recount", "fats_free_recount %llu.\r\n", free_count);
+    fat_rep_uint(&fc->rep, "next_free", "fats_next_free %llu.\r\n", next_free);
+    if ((fatfs->fat_type == FAT_TYPE_FAT32) && fatfs->fsinfo_valid)
+    {
+        fat_rep_uint(&fc->rep, "fsinfo_free_count", "fsinfo_free_count %llu.\r\n", fatfs->free_count);
+        fat_rep_uint(&fc->rep, "fsinfo_next_free", "fsinfo_next_free %llu.\r\n", fatfs->next_free);
+    }
+    fat_rep_end(&fc->rep);
+    if ((fatfs->fat_type != FAT_TYPE_FAT32) || !fatfs->fsinfo_valid)
+    {
+        return 0;
+    }
+    // unknown counters are legal, a stale count is not.
+    if ((fatfs->free_count != FAT_FSINFO_UNKNOWN) && (fatfs->free_count != free_count))
+    {
+        fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "fsinfo", "FSInfo free count %u is wrong, %u clusters are free.", fatfs->free_count, free_count);
+        fc->error = fc->error + 1;
+    }
+    if ((fatfs->next_free != FAT_FSINFO_UNKNOWN) && ((fatfs->next_free < 2) || (fatfs->next_free >= fc->fat_entries)))
+    {
+        fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "fsinfo", "FSInfo next free %u is out of range, hint should be %u.", fatfs->next_free, next_free);
+        fc->error = fc->error + 1;
+    }
+    return 0;
+}
+
+static int fat_fats_mirror(fat_ck_t* fc)
+{
+    uint8_t* left_buff = NULL;
+    uint8_t* right_buff = NULL;
+    const uint8_t* left = NULL;
+    const uint8_t* right = NULL;
+    uint8_t  fat_type = fc->fatfs.fat_type;
+    uint64_t fats_addr = (uint64_t)fc->fatfs.fats_sector_start * fc->device->sector_size;
+    uint64_t fat_bytes = (uint64_t)fc->fatfs.fat_size * fc->device->sector_size;
+    uint64_t copy_addr = 0;
+    uint64_t load_addr = 0;
+    uint64_t diff_addr = 0;
+    uint64_t fats_size = ((uint64_t)fc->fat_entries * FAT_ENTRY_BITS(fat_type) + 7) / 8;
+    size_t load_size = 0;
+    size_t diff = 0;
+    uint32_t copy = 0;
+    uint32_t first = 0;
+    uint32_t last = 0;
+    uint32_t next = 0;
+    uint32_t index = 0;
+    uint32_t entry = 0;
+    uint32_t left_value = 0;
+    uint32_t right_value = 0;
+    uint32_t first_left = 0;
+    uint32_t first_right = 0;
+    uint32_t ranges = 0;
+    uint32_t entries = 0;
+    int result = 0;
+
+    left_buff = (uint8_t*)malloc(FAT_MIRROR_SIZE);
+    right_buff = (uint8_t*)malloc(FAT_MIRROR_SIZE);
+    if ((left_buff == NULL) || (right_buff == NULL))
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat mirror buffer malloc failed.");
+        free(left_buff);
+        free(right_buff);
+        return -1;
+    }
+    // stream FAT #1 against every other copy, equal blocks cost one vector compare.
+    for (copy = 1; (copy < fc->fatfs.bpb.BPB_NumFATs) && (result == 0); copy++)
+    {
+        copy_addr = fats_addr + fat_bytes * copy;
+        load_addr = 0;
+        next = 0;
+        while (load_addr < fats_size)
+        {
+            load_size = (size_t)(((fats_size - load_addr) < FAT_MIRROR_SIZE) ? (fats_size - load_addr) : FAT_MIRROR_SIZE);
+            left = fat_fats_block(fc, fats_addr + load_addr, left_buff, load_size);
+            right = fat_fats_block(fc, copy_addr + load_addr, right_buff, load_size);
+            if ((left == NULL) || (right == NULL))
+            {
+                fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat mirror read at 0x%08llX failed.", (unsigned long long)(copy_addr + load_addr));
+                result = -1;
+                break;
+            }
+            diff = fat_simd_compare(left, right, load_size);
+            if (diff == load_size)
+            {
+                load_addr = load_addr + load_size;
+                continue;
+            }
+            // a FAT12 byte holds parts of two entries, start at the first one of them that differs.
+            diff_addr = load_addr + diff;
+            first = (uint32_t)((diff_addr * 8) / FAT_ENTRY_BITS(fat_type));
+            last = (uint32_t)((diff_addr * 8 + 7) / FAT_ENTRY_BITS(fat_type));
+            first = (first > next) ? first : next;
+            for (; (first < last) && (first < fc->fat_entries); first++)
+            {
+                if ((fat_fats_raw(fc, fats_addr, first, &left_value) < 0) ||
+                    (fat_fats_raw(fc, copy_addr, first, &right_value) < 0) ||
+                    (left_value != right_value))
+                {
+                    break;
+                }
+            }
+            // grow it into a run of differing entries.
+            for (index = first; index < fc->fat_entries; index++)
+            {
+                if ((fat_fats_raw(fc, fats_addr, index, &left_value) < 0) ||
+                    (fat_fats_raw(fc, copy_addr, index, &right_value) < 0) ||
+                    (left_value == right_value))
+                {
+                    break;
+                }
+                if (index == first)
+                {
+                    first_left = left_value;
+                    first_right = right_value;
+                }
+            }
+            if (index > first)
+            {
+                if (ranges < FAT_MIRROR_REPORT)
+                {
+                    fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "mirror", "Mirror [FAT%u]: entries %u..%u differ, 0x%08X vs 0x%08X.",
+                        copy + 1, first, index - 1, first_left, first_right);
+                }
+                ranges = ranges + 1;
+                entries = entries + (index - first);
+                // the first FAT wins, chains are checked against it.
+                for (entry = first; (fc->fix != NULL) && (entry < index); entry++)
+                {
+                    if ((fat_fats_raw(fc, fats_addr, entry, &left_value) < 0) ||
+                        (fat_repair_raw(fc, copy_addr, entry, left_value, 0xFFFFFFFF) < 0))
+                    {
+                        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat mirror repair of entry %u failed.", entry);
+                        result = -1;
+                        break;
+                    }
+                }
+                if ((fc->fix != NULL) && (ranges <= FAT_MIRROR_REPORT))
+                {
+                    fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "repair", "Repair [FAT%u]: entries %u..%u copied from FAT1.", copy + 1, first, index - 1);
+                }
+                if (result < 0)
+                {
+                    break;
+                }
+            }
+            // resume after the compared entries, an entry sharing the byte is never reported twice.
+            next = (index > first) ? index : (first + 1);
+            load_addr = ((uint64_t)next * FAT_ENTRY_BITS(fat_type)) / 8;
+            load_addr = (load_addr > diff_addr) ? load_addr : (diff_addr + 1);
+        }
+    }
+    free(left_buff);
+    free(right_buff);
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "mirror");
+    fat_rep_uint(&fc->rep, "copies", "fats_mirror_copies %llu.\r\n", fc->fatfs.bpb.BPB_NumFATs);
+    fat_rep_uint(&fc->rep, "ranges", "fats_mirror_ranges %llu.\r\n", ranges);
+    fat_rep_uint(&fc->rep, "entries", "fats_mirror_entries %llu.\r\n", entries);
+    fat_rep_end(&fc->rep);
+    fc->error = fc->error + ranges;
+    return result;
+}
+
+static int fat_fats_check(fat_ck_t* fc)
+{
+    fat_clus_stat_t* stat = &fc->clus_stat;
+
+    // the entries were classified window by window as they were loaded.
+    fat_rep_text(&fc->rep, FAT_REP_SUMMARY, "\r\n");
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "fat");
+    fat_rep_str(&fc->rep, "classify_mode", "fats_classify_mode %s.\r\n", fat_simd_name());
+    fat_rep_uint(&fc->rep, "clusters_free", "fats_clusters_free %llu.\r\n", stat->free);
+    fat_rep_uint(&fc->rep, "clusters_used", "fats_clusters_used %llu.\r\n", stat->used + stat->end);
+    fat_rep_uint(&fc->rep, "clusters_chains", "fats_clusters_chains %llu.\r\n", stat->end);
+    fat_rep_uint(&fc->rep, "clusters_bad", "fats_clusters_bad %llu.\r\n", stat->bad);
+    fat_rep_uint(&fc->rep, "clusters_reserved", "fats_clusters_reserved %llu.\r\n", stat->reserved);
+    fat_rep_end(&fc->rep);
+    return 0;
+}
+
+static uint32_t fat_fats_count(fat_ck_t* fc, uint32_t index)
+{
+    uint32_t value = 0;
+    uint32_t count = 0;
+    uint32_t run = 0;
+
+    // follow the chain extent by extent, a chain longer than the FAT is a loop.
+    while ((index >= 2) && (index < fc->fat_entries) && (count < fc->fat_entries))
+    {
+        run = fat_link_run(fc, index, &value);
+        count = count + run;
+        if (FAT32_CLUS_END(value))
+        {
+            return count;
+        }
+        if (!FAT32_CLUS_USE(value))
+        {
+            break;
+        }
+        index = value;
+    }
+    return 0;
+}
+
+static bool fat_chain_seen(fat_ck_t* fc, uint32_t index, uint32_t target, uint32_t count)
+{
+    uint32_t step = 0;
+    for (step = 0; step < count; step++)
+    {
+        if (index == target)
+        {
+            return true;
+        }
+        index = fat_link(fc, index);
+    }
+    return false;
+}
+
+// first cluster in [start, start + count) holding every bit of state, count when there is none.
+static uint32_t fat_state_first(const uint8_t* map, uint32_t start, uint32_t count, uint32_t state)
+{
+    uint32_t index = start;
+    uint32_t stop = start + count;
+    uint64_t word = 0;
+
+    // single clusters up to a byte boundary, then 32 clusters per step.
+    while ((index < stop) && (index & 3))
+    {
+        if ((FAT_STATE_GET(map, index) & state) == state)
+        {
+            return index - start;
+        }
+        index = index + 1;
+    }
+    while (index + 32 <= stop)
+    {
+        memcpy(&word, map + (index >> 2), sizeof(word));
+        word = (state == FAT_STATE_CROSS) ? (word & (word >> 1) & 0x5555555555555555ULL) : (word & 0xAAAAAAAAAAAAAAAAULL);
+        if (word != 0)
+        {
+            break;
+        }
+        index = index + 32;
+    }
+    for (; index < stop; index++)
+    {
+        if ((FAT_STATE_GET(map, index) & state) == state)
+        {
+            return index - start;
+        }
+    }
+    return count;
+}
+
+// claim unowned clusters, a link mark left by the lost scan is dropped.
+static void fat_state_own(uint8_t* map, uint32_t start, uint32_t count)
+{
+    uint32_t index = start;
+    uint32_t stop = start + count;
+    while ((index < stop) && (index & 3))
+    {
+        FAT_STATE_PUT(map, index, FAT_STATE_OWNED);
+        index = index + 1;
+    }
+    // whole bytes of an extent at once.
+    if (stop - index >= 4)
+    {
+        memset(map + (index >> 2), 0xAA, (stop - index) >> 2);
+        index = index + ((stop - index) & ~3u);
+    }
+    for (; index < stop; index++)
+    {
+        FAT_STATE_PUT(map, index, FAT_STATE_OWNED);
+    }
+}
+
+static void fat_chain_repair(fat_ck_t* fc, uint32_t start, uint32_t last)
+{
+    if (fc->fix == NULL)
+    {
+        return;
+    }
+    // the chain ends at its last good cluster, a bad head needs its entry fixed.
+    if (last == 0)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "repair", "Repair [0x%08X]: start cluster is broken, chain left as is.", start);
+        return;
+    }
+    if (fat_repair_entry(fc, last, 0x0FFFFFFF) == 0)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "repair", "Repair [0x%08X]: chain truncated at cluster %u.", start, last);
+    }
+}
+
+static void fat_chain_ranges(fat_ck_t* fc, uint32_t start, uint32_t count)
+{
+    uint32_t index = start;
+    uint32_t tail = 0;
+    uint32_t run = 0;
+
+    // the marked part of a chain, one call per extent.
+    while (count > 0)
+    {
+        run = fat_link_run(fc, index, &tail);
+        tail = (run > count) ? (index + count) : tail;
+        run = (run < count) ? run : count;
+        fc->calls.chain(fc->calls.user, start, index, run);
+        count = count - run;
+        index = tail;
+    }
+}
+
+static int fat_chain_mark(fat_ck_t* fc, uint32_t start)
+{
+    int result = 0;
+    uint32_t index = start;
+    uint32_t last = 0;
+    uint32_t value = 0;
+    uint32_t count = 0;
+    uint32_t run = 0;
+    uint32_t hit = 0;
+    uint32_t extents = 0;
+    fat_chain_t* chains = NULL;
+
+    // mark the chain in the state map, one range per extent.
+    while (true)
+    {
+        if ((index < 2) || (index >= fc->fat_entries))
+        {
+            fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "chain", "Chain [0x%08X]: cluster %u out of range.", start, index);
+            fat_chain_repair(fc, start, last);
+            result = -1;
+            break;
+        }
+        run = fat_link_run(fc, index, &value);
+        hit = fat_state_first(fc->state_map, index, run, FAT_STATE_OWNED);
+        fat_state_own(fc->state_map, index, hit);
+        count = count + hit;
+        extents = extents + ((hit > 0) ? 1 : 0);
+        // the extent runs into an owned cluster, the chain stops before it.
+        if (hit < run)
+        {
+            last = (hit > 0) ? (index + hit - 1) : last;
+            index = index + hit;
+            if (fat_chain_seen(fc, start, index, count))
+            {
+                fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "chain", "Chain [0x%08X]: loop back to cluster %u.", start, index);
+            }
+            else
+            {
+                fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "chain", "Chain [0x%08X]: cluster %u cross-linked.", start, index);
+                if (FAT_STATE_GET(fc->state_map, index) != FAT_STATE_CROSS)
+                {
+                    FAT_STATE_PUT(fc->state_map, index, FAT_STATE_CROSS);
+                    fc->dup_count = fc->dup_count + 1;
+                }
+            }
+            fat_chain_repair(fc, start, last);
+            result = -1;
+            break;
+        }
+        index = index + run - 1;
+        if (FAT32_CLUS_END(value))
+        {
+            break;
+        }
+        if (!FAT32_CLUS_USE(value))
+        {
+            fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "chain", "Chain [0x%08X]: cluster %u links to %s cluster.", start, index, FAT32_CLUS_BAD(value) ? "bad" : "free");
+            fat_chain_repair(fc, start, index);
+            result = -1;
+            break;
+        }
+        last = index;
+        index = value;
+    }
+    fc->own_count = fc->own_count + count;
+    FAT_STAT_ADD(fc, clusters_visited, count);
+    FAT_STAT_ADD(fc, chain_extents, extents);
+    FAT_STAT_ADD(fc, chains_fragmented, (extents > 1) ? 1 : 0);
+    if (fc->calls.chain != NULL)
+    {
+        fat_chain_ranges(fc, start, count);
+    }
+    fc->error = (result < 0) ? (fc->error + 1) : fc->error;
+    // record the chain for the conflict owner pass.
+    if (fc->chain_count >= fc->chain_limit)
+    {
+        fc->chain_limit = (fc->chain_limit == 0) ? 0x100 : (fc->chain_limit * 2);
+        chains = (fat_chain_t*)realloc(fc->chains, fc->chain_limit * sizeof(fat_chain_t));
+        if (chains == NULL)
+        {
+            fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat chain list malloc failed.");
+            return -1;
+        }
+        fc->chains = chains;
+    }
+    fc->chains[fc->chain_count].start = start;
+    fc->chains[fc->chain_count].count = count;
+    fc->chain_count = fc->chain_count + 1;
+    return result;
+}
+
+static int fat_chain_owners(fat_ck_t* fc)
+{
+    uint32_t chain = 0;
+    uint32_t index = 0;
+    uint32_t left = 0;
+    uint32_t tail = 0;
+    uint32_t run = 0;
+    uint32_t hit = 0;
+
+    // find the first owners of cross-linked clusters, each extent is one range test.
+    for (chain = 0; (chain < fc->chain_count) && (fc->dup_count > 0); chain++)
+    {
+        index = fc->chains[chain].start;
+        for (left = fc->chains[chain].count; left > 0; left = left - run)
+        {
+            run = fat_link_run(fc, index, &tail);
+            tail = (run > left) ? (index + left) : tail;
+            run = (run < left) ? run : left;
+            for (hit = fat_state_first(fc->state_map, index, run, FAT_STATE_CROSS); hit < run; hit = hit + 1 + fat_state_first(fc->state_map, index + hit + 1, run - hit - 1, FAT_STATE_CROSS))
+            {
+                fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "chain", "Chain [0x%08X]: owns cross-linked cluster %u.", fc->chains[chain].start, index + hit);
+            }
+            index = tail;
+        }
+        FAT_STAT_ADD(fc, clusters_visited, fc->chains[chain].count);
+    }
+    fat_rep_text(&fc->rep, FAT_REP_SUMMARY, "\r\n");
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "chains");
+    fat_rep_uint(&fc->rep, "checked", "chains_checked %llu.\r\n", fc->chain_count);
+    fat_rep_uint(&fc->rep, "clusters", "chains_clusters %llu.\r\n", fc->own_count);
+    fat_rep_uint(&fc->rep, "cross_linked", "chains_cross_linked %llu.\r\n", fc->dup_count);
+    fat_rep_uint(&fc->rep, "errors", "chains_errors %llu.\r\n", fc->error);
+    fat_rep_end(&fc->rep);
+    return (fc->error > 0) ? -1 : 0;
+}
+
+// used cluster i with FAT value v that no chain owns.
+#define FAT_LOST_USED(fc, i, v) ((FAT32_CLUS_USE(v) || FAT32_CLUS_END(v)) && !(FAT_STATE_GET((fc)->state_map, i) & FAT_STATE_OWNED))
+
+static int fat_lost_walk(fat_ck_t* fc, uint32_t start)
+{
+    uint32_t index = start;
+    uint32_t value = 0;
+    uint32_t tail = 0;
+    uint32_t count = 0;
+    uint32_t run = 0;
+    uint32_t hit = 0;
+    fat_chain_t* lost = NULL;
+
+    // every cluster is claimed once, the scan stays linear in the FAT size.
+    while (true)
+    {
+        // inside an extent the links are in use, only an owned cluster or the extent tail can end it.
+        run = fat_link_run(fc, index, &tail);
+        hit = 1 + fat_state_first(fc->state_map, index + 1, run - 1, FAT_STATE_OWNED);
+        if ((hit == run) && (run > 1) && !FAT_LOST_USED(fc, index + run - 1, tail))
+        {
+            hit = run - 1;
+        }
+        fat_state_own(fc->state_map, index, hit);
+        count = count + hit;
+        value = (hit == run) ? tail : (index + hit);
+        index = index + hit - 1;
+        if ((hit == run) && FAT32_CLUS_END(value))
+        {
+            break;
+        }
+        if ((hit < run) || (value >= fc->fat_entries) || !FAT_LOST_USED(fc, value, fat_link(fc, value)))
+        {
+            // runs into a claimed, free or bad cluster, the lost chain ends here.
+            if ((fc->fix != NULL) && (fat_repair_entry(fc, index, 0x0FFFFFFF) < 0))
+            {
+                return -1;
+            }
+            break;
+        }
+        index = value;
+    }
+    if (fc->lost_count >= fc->lost_limit)
+    {
+        fc->lost_limit = (fc->lost_limit == 0) ? 0x40 : (fc->lost_limit * 2);
+        lost = (fat_chain_t*)realloc(fc->lost, fc->lost_limit * sizeof(fat_chain_t));
+        if (lost == NULL)
+        {
+            fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat lost chain list malloc failed.");
+            return -1;
+        }
+        fc->lost = lost;
+    }
+    fc->lost[fc->lost_count].start = start;
+    fc->lost[fc->lost_count].count = count;
+    fc->lost_count = fc->lost_count + 1;
+    fc->lost_clusters = fc->lost_clusters + count;
+    FAT_STAT_ADD(fc, clusters_visited, count);
+    if (fc->calls.chain != NULL)
+    {
+        fat_chain_ranges(fc, start, count);
+    }
+    if (fc->lost_count <= FAT_LOST_REPORT)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "lost", "Lost [0x%08X]: chain of %u clusters.", start, count);
+    }
+    return 0;
+}
+
+static int fat_lost_scan(fat_ck_t* fc)
+{
+    const uint32_t* table = NULL;
+    uint32_t base = 0;
+    uint32_t stop = 0;
+    uint32_t index = 0;
+    uint32_t value = 0;
+    uint32_t used = 0;
+    int pass = 0;
+    int result = 0;
+
+    // owners are only known when the whole tree was walked.
+    if (fc->dirs_skipped > 0)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "lost", "Lost chain scan skipped, %u directories were not walked.", fc->dirs_skipped);
+        return 0;
+    }
+    // an unowned cluster no other unowned cluster links to is a chain head, the links are marked in the state map.
+    for (base = 0; (base < fc->fat_entries) && (result == 0); base = stop)
+    {
+        stop = ((fc->fat_entries - base) < fc->win.entries) ? fc->fat_entries : (base + fc->win.entries);
+        table = fat_win_scan(fc, base, stop);
+        result = (table != NULL) ? 0 : -1;
+        for (index = (base < 2) ? 2 : base; (index < stop) && (result == 0); index++)
+        {
+            value = table[index - base];
+            if (!FAT_LOST_USED(fc, index, value))
+            {
+                continue;
+            }
+            used = used + 1;
+            if (FAT32_CLUS_USE(value) && (value < fc->fat_entries) && (FAT_STATE_GET(fc->state_map, value) == FAT_STATE_NONE))
+            {
+                FAT_STATE_PUT(fc->state_map, value, FAT_STATE_LINKED);
+            }
+        }
+    }
+    // walk the heads first, whatever is left afterwards are headless loops, no pass once every lost cluster is claimed.
+    for (pass = 0; (pass < 2) && (result == 0) && (fc->lost_clusters < used); pass++)
+    {
+        for (base = 0; (base < fc->fat_entries) && (result == 0) && (fc->lost_clusters < used); base = stop)
+        {
+            stop = ((fc->fat_entries - base) < fc->win.entries) ? fc->fat_entries : (base + fc->win.entries);
+            table = fat_win_scan(fc, base, stop);
+            result = (table != NULL) ? 0 : -1;
+            for (index = (base < 2) ? 2 : base; (index < stop) && (result == 0); index++)
+            {
+                value = table[index - base];
+                if (FAT_LOST_USED(fc, index, value) && ((pass > 0) || (FAT_STATE_GET(fc->state_map, index) != FAT_STATE_LINKED)))
+                {
+                    result = fat_lost_walk(fc, index);
+                }
+            }
+        }
+    }
+    fat_rep_text(&fc->rep, FAT_REP_SUMMARY, "\r\n");
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "lost");
+    fat_rep_uint(&fc->rep, "chains", "lost_chains %llu.\r\n", fc->lost_count);
+    fat_rep_uint(&fc->rep, "clusters", "lost_clusters %llu.\r\n", fc->lost_clusters);
+    fat_rep_end(&fc->rep);
+    fc->error = fc->error + fc->lost_count;
+    return result;
+}
+
+// utf-8 length by utf-16 unit >> 11, 0 marks the surrogate block.
+static const uint8_t fat_utf8_size[0x20] =
+{
+    2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 3, 3, 3, 3,
+};
+
+static uint8_t fat_lfn_checksum(const uint8_t* sfn)
+{
+    uint8_t sum = 0;
+    int index = 0;
+    for (index = 0; index < 11; index++)
+    {
+        sum = (uint8_t)(((sum & 1) ? 0x80 : 0) + (sum >> 1) + sfn[index]);
+    }
+    return sum;
+}
+
+static void fat_lfn_collect(fat_dir_scan_t* scan, const uint8_t* entry)
+{
+    uint8_t ord = entry[FAT_LFN_ORD] & FAT_LFN_ORD_MASK;
+    uint16_t* part = NULL;
+    int index = 0;
+
+    // fragments are stored last first, each one must follow its predecessor.
+    if (entry[FAT_LFN_ORD] & FAT_LFN_ORD_LAST)
+    {
+        scan->lfn_count = ord;
+        scan->lfn_next = ord;
+        scan->lfn_sum = entry[FAT_LFN_CHKSUM];
+    }
+    if ((ord == 0) || ((ord * FAT_LFN_PART_CHARS) > FAT_LFN_CHARS) || (ord != scan->lfn_next) || (entry[FAT_LFN_CHKSUM] != scan->lfn_sum))
+    {
+        scan->lfn_count = 0;
+        scan->lfn_next = 0;
+        return;
+    }
+    part = &scan->lfn[(ord - 1) * FAT_LFN_PART_CHARS];
+    for (index = FAT_LFN_1_START; index <= FAT_LFN_1_END; index = index + 2)
+    {
+        *part++ = (uint16_t)FAT_GET_UINT16(&entry[index]);
+    }
+    for (index = FAT_LFN_2_START; index <= FAT_LFN_2_END; index = index + 2)
+    {
+        *part++ = (uint16_t)FAT_GET_UINT16(&entry[index]);
+    }
+    for (index = FAT_LFN_3_START; index <= FAT_LFN_3_END; index = index + 2)
+    {
+        *part++ = (uint16_t)FAT_GET_UINT16(&entry[index]);
+    }
+    scan->lfn_next = ord - 1;
+}
+
+static size_t fat_lfn_utf8(const uint16_t* chars, size_t count, uint8_t* name, size_t size)
+{
+    size_t index = 0;
+    size_t used = 0;
+    uint32_t code = 0;
+    uint8_t width = 0;
+
+    // the name ends at 0x0000, the rest of the last fragment is 0xFFFF padding.
+    for (index = 0; (index < count) && (chars[index] != 0x0000) && (chars[index] != 0xFFFF); index++)
+    {
+        code = chars[index];
+        if (code < 0x80)
+        {
+            if (used + 1 >= size)
+            {
+                break;
+            }
+            name[used++] = (uint8_t)code;
+            continue;
+        }
+        width = fat_utf8_size[code >> 11];
+        if (width == 0)
+        {
+            // a high surrogate followed by a low one, anything else is replaced.
+            if ((code < 0xDC00) && (index + 1 < count) && (chars[index + 1] >= 0xDC00) && (chars[index + 1] <= 0xDFFF))
+            {
+                code = 0x10000 + ((code - 0xD800) << 10) + (chars[index + 1] - 0xDC00);
+                index = index + 1;
+                width = 4;
+            }
+            else
+            {
+                code = 0xFFFD;
+                width = 3;
+            }
+        }
+        if (used + width >= size)
+        {
+            break;
+        }
+        switch (width)
+        {
+        case 2:
+            name[used++] = (uint8_t)(0xC0 | (code >> 6));
+            break;
+        case 3:
+            name[used++] = (uint8_t)(0xE0 | (code >> 12));
+            name[used++] = (uint8_t)(0x80 | ((code >> 6) & 0x3F));
+            break;
+        default:
+            name[used++] = (uint8_t)(0xF0 | (code >> 18));
+            name[used++] = (uint8_t)(0x80 | ((code >> 12) & 0x3F));
+            name[used++] = (uint8_t)(0x80 | ((code >> 6) & 0x3F));
+            break;
+        }
+        name[used++] = (uint8_t)(0x80 | (code & 0x3F));
+    }
+    name[used] = '\0';
+    return used;
+}
+
+static int fat_sfn_read(char name[FAT_SFN_SIZE], uint8_t attr)
+{
+    size_t index = 0;
+    size_t useds = 0;
+    size_t start = 0;
+    size_t limit = 0;
+    size_t point = 0;
+    char temp[FAT_SFN_SIZE] = { 0 };
+
+    switch (attr)
+    {
+    case SFN_BODY_LOW_CASE:
+        start = FAT_SFN_BODY_START; limit = FAT_SFN_BODY_END;
+        break;
+    case SFN_EXTE_LOW_CASE:
+        start = FAT_SFN_EXTE_START; limit = FAT_SFN_EXTE_END;
+        break;
+    case SFN_ALLS_LOW_CASE:
+        start = FAT_SFN_BODY_START; limit = FAT_SFN_EXTE_END;
+        break;
+    default:
+        start = FAT_SFN_BODY_START; limit = FAT_SFN_BODY_START;
+        break;
+    }
+    memset(temp, 0, FAT_SFN_SIZE);
+    // uper char transfer to lower char.
+    for (index = 0; ((index < FAT_SFN_SIZE) && (useds < FAT_SFN_SIZE)); index++)
+    {
+        if ((index >= start) && (index <= limit) && (name[index] >= 'A') && (name[index] <= 'Z'))
+        {
+            name[index] = tolower(name[index]);
+        }
+        if (name[index] > ' ')
+        {
+            temp[useds] = name[index];
+            useds = useds + 1;
+        }
+        if (index == FAT_SFN_BODY_END)
+        {
+            point = useds;
+            temp[useds] = '.';
+            useds = useds + 1;
+        }
+    }
+    if (useds < FAT_SFN_SIZE)
+    {
+        if ((point > 0) && (point == (useds - 1)))
+        {
+            temp[point] = '\0';
+        }
+        else
+        {
+            temp[useds] = '\0';
+        }
+    }
+    else
+    {
+        temp[FAT_SFN_SIZE - 1] = '\0';
+    }
+    memcpy(name, temp, FAT_SFN_SIZE);
+    return 0;
+}
+
+static fat_dir_node_t* fat_dirs_claim(fat_ck_t* fc, uint32_t cluster)
+{
+    fat_dir_node_t** bucket = &fc->dir_nodes[cluster % fc->dir_bucket_count];
+    fat_dir_node_t* node = NULL;
+
+    // the first claim of a directory cluster owns its parse job.
+    fat_mutex_lock(&fc->dir_lock);
+    for (node = *bucket; node != NULL; node = node->hash)
+    {
+        if (node->cluster == cluster)
+        {
+            fat_mutex_unlock(&fc->dir_lock);
+            return NULL;
+        }
+    }
+    node = (fat_dir_node_t*)calloc(1, sizeof(fat_dir_node_t));
+    if (node != NULL)
+    {
+        node->cluster = cluster;
+        node->hash = *bucket;
+        *bucket = node;
+    }
+    fat_mutex_unlock(&fc->dir_lock);
+    return node;
+}
+
+static fat_dir_node_t* fat_dirs_find(fat_ck_t* fc, uint32_t cluster)
+{
+    fat_dir_node_t* node = NULL;
+    for (node = fc->dir_nodes[cluster % fc->dir_bucket_count]; node != NULL; node = node->hash)
+    {
+        if (node->cluster == cluster)
+        {
+            break;
+        }
+    }
+    return node;
+}
+
+static void fat_dirs_free(fat_ck_t* fc)
+{
+    uint32_t bucket = 0;
+    uint32_t index = 0;
+    fat_dir_node_t* node = NULL;
+    for (bucket = 0; (fc->dir_nodes != NULL) && (bucket < fc->dir_bucket_count); bucket++)
+    {
+        while (fc->dir_nodes[bucket] != NULL)
+        {
+            node = fc->dir_nodes[bucket];
+            fc->dir_nodes[bucket] = node->hash;
+            for (index = 0; index < node->item_count; index++)
+            {
+                free(node->items[index].name);
+            }
+            free(node->items);
+            free(node);
+        }
+    }
+    free(fc->dir_nodes);
+    fc->dir_nodes = NULL;
+}
+
+static int fat_dirs_add(fat_dir_node_t* node, const fat_dir_t* dir, const char* name)
+{
+    fat_dir_item_t* items = NULL;
+    size_t size = strlen(name) + 1;
+    if (node->item_count >= node->item_limit)
+    {
+        node->item_limit = (node->item_limit == 0) ? 0x10 : (node->item_limit * 2);
+        items = (fat_dir_item_t*)realloc(node->items, node->item_limit * sizeof(fat_dir_item_t));
+        if (items == NULL)
+        {
+            printf("fat dir item malloc failed.\r\n");
+            return -1;
+        }
+        node->items = items;
+    }
+    node->items[node->item_count].dir = *dir;
+    node->items[node->item_count].name = (char*)malloc(size);
+    if (node->items[node->item_count].name == NULL)
+    {
+        printf("fat dir name malloc failed.\r\n");
+        return -1;
+    }
+    memcpy(node->items[node->item_count].name, name, size);
+    node->item_count = node->item_count + 1;
+    return 0;
+}
+
+static int fat_dirs_check(fat_ck_t* fc, fat_dir_node_t* node, fat_dir_scan_t* scan, uint64_t start, uint64_t end)
+{
+    uint32_t sector_size = fc->device->sector_size;
+    uint32_t offset = 0;
+    const uint8_t* sector = NULL;
+    const uint8_t* dir_info = NULL;
+    fat_dir_t dir = { 0 };
+    uint8_t lfn_buf[FAT_LFN_SIZE] = { 0x00 };
+
+    // one sector per read, every entry is decoded straight from it.
+    for (; start < end; start = start + sector_size)
+    {
+        sector = fat_ck_peek(fc, start, scan->buff, sector_size);
+        if (sector == NULL)
+        {
+            return 0;
+        }
+        for (offset = 0; offset < sector_size; offset = offset + FAT_DIR_ENTRY_SIZE)
+        {
+            dir_info = sector + offset;
+            scan->entries = scan->entries + 1;
+            // end of directory.
+            if (dir_info[0] == '\0')
+            {
+                return 0;
+            }
+            // this is "." or ".." dir
+            if (IS_CURRENT_DIR(dir_info) || IS_PARENTS_DIR(dir_info))
+            {
+                continue;
+            }
+            // this is deleted entry, its chain was freed.
+            if (IS_DELETED_DIR(dir_info))
+            {
+                scan->lfn_count = 0;
+                scan->lfn_next = 0;
+                continue;
+            }
+            // this is long file name, collected until its short entry.
+            if (dir_info[DIR_ATTR] == ATTR_LONG_FILE_NAME)
+            {
+                fat_lfn_collect(scan, dir_info);
+                continue;
+            }
+            // this is short file name or other files.
+            if (dir_info[DIR_ATTR] != ATTR_READ_ONLY && \
+                dir_info[DIR_ATTR] != ATTR_HIDDEN    && \
+                dir_info[DIR_ATTR] != ATTR_SYSTEM    && \
+                dir_info[DIR_ATTR] != ATTR_VOLUME_ID && \
+                dir_info[DIR_ATTR] != ATTR_DIRECTORY && \
+                dir_info[DIR_ATTR] != ATTR_ARCHIVE)
+            {
+                return -1;
+            }
+            memset(&dir, 0, sizeof(fat_dir_t));
+            strncpy(dir.DIR_Name, dir_info, FAT_SFN_SIZE - 2);
+            dir.DIR_Attr = dir_info[DIR_ATTR];
+            dir.DIR_NTRes = dir_info[DIR_NTRES];
+            dir.DIR_CrtTimeTenth = dir_info[DIR_CRT_TIME_TENTH];
+            dir.DIR_CrtTime = FAT_GET_UINT16(&dir_info[DIR_CRT_TIME]);
+            dir.DIR_CrtDate = FAT_GET_UINT16(&dir_info[DIR_CRT_DATE]);
+            dir.DIR_LstAccDate = FAT_GET_UINT16(&dir_info[DIR_LST_ACC_DATE]);
+            dir.DIR_FstClusHI = FAT_GET_UINT16(&dir_info[DIR_FST_CLUS_HI]);
+            dir.DIR_WrtTime = FAT_GET_UINT16(&dir_info[DIR_WRT_TIME]);
+            dir.DIR_WrtDate = FAT_GET_UINT16(&dir_info[DIR_WRT_DATE]);
+            dir.DIR_FstClusLO = FAT_GET_UINT16(&dir_info[DIR_FST_CLUS_LO]);
+            dir.DIR_FileSize = FAT_GET_UINT32(&dir_info[DIR_FILE_SIZE]);
+            fat_sfn_read(dir.DIR_Name, dir.DIR_NTRes);
+            // the long name belongs to this entry only when complete and its checksum matches.
+            if ((scan->lfn_count > 0) && (scan->lfn_next == 0) && (scan->lfn_sum == fat_lfn_checksum(dir_info)))
+            {
+                fat_lfn_utf8(scan->lfn, (size_t)scan->lfn_count * FAT_LFN_PART_CHARS, lfn_buf, FAT_LFN_SIZE);
+                fat_dirs_add(node, &dir, (const char*)lfn_buf);
+            }
+            else
+            {
+                fat_dirs_add(node, &dir, (const char*)dir.DIR_Name);
+            }
+            scan->lfn_count = 0;
+            scan->lfn_next = 0;
+        }
+    }
+    return -1;
+}
+
+static void fat_ra_init(fat_ck_t* fc, fat_ra_t* ra, uint32_t cluster, uint32_t count)
+{
+    // the first cluster is read right away, look ahead from the second.
+    ra->cluster = (count > 1) ? fat_link(fc, cluster) : 0;
+    ra->left = (count > 1) ? (count - 1) : 0;
+    ra->ahead = 0;
+    ra->window = FAT_RA_MIN;
+}
+
+static void fat_ra_issue(fat_ck_t* fc, fat_ra_t* ra)
+{
+    uint32_t clus_size = fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size;
+    uint64_t addr = 0;
+    uint64_t size = 0;
+
+    // advise the next clusters of the validated chain, one hint per contiguous run.
+    while ((ra->left > 0) && (ra->ahead < ra->window))
+    {
+        if ((size > 0) && (fat_clus_addr(fc, ra->cluster) != (addr + size)))
+        {
+            fat_dev_advise(fc->device, addr, size);
+            size = 0;
+        }
+        if (size == 0)
+        {
+            addr = fat_clus_addr(fc, ra->cluster);
+        }
+        size = size + clus_size;
+        ra->cluster = fat_link(fc, ra->cluster);
+        ra->left = ra->left - 1;
+        ra->ahead = ra->ahead + 1;
+    }
+    if (size > 0)
+    {
+        fat_dev_advise(fc->device, addr, size);
+    }
+}
+
+static void fat_ra_tune(fat_ra_t* ra, uint64_t latency)
+{
+    // a slow hop means the hints did not run far enough ahead.
+    ra->ahead = (ra->ahead > 0) ? (ra->ahead - 1) : 0;
+    if ((latency > FAT_RA_STALL_US) && (ra->window < FAT_RA_MAX))
+    {
+        ra->window = ra->window * 2;
+    }
+}
+
+static void fat_dirs_hash(fat_ck_t* fc, fat_dir_scan_t* scan, uint64_t start, uint32_t size)
+{
+    const uint8_t* data = NULL;
+    if (scan->hash_buff == NULL)
+    {
+        return;
+    }
+    // an unreadable region is never cached.
+    data = fat_ck_peek(fc, start, scan->hash_buff, size);
+    if (data == NULL)
+    {
+        free(scan->hash_buff);
+        scan->hash_buff = NULL;
+        return;
+    }
+    scan->hash = fat_hash64(data, size, scan->hash);
+    scan->hash_count = scan->hash_count + 1;
+}
+
+static uint32_t fat_dirs_region(fat_ck_t* fc, uint32_t cluster)
+{
+    // bytes hashed at once, the fixed root region or one cluster.
+    if (cluster == 0)
+    {
+        return fc->fatfs.root_sector_count * fc->device->sector_size;
+    }
+    return fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size;
+}
+
+static void fat_dirs_store(fat_ck_t* fc, fat_dir_node_t* node, fat_dir_scan_t* scan, int result)
+{
+    uint8_t* data = NULL;
+    uint8_t* item = NULL;
+    uint32_t size = 8;
+    uint32_t index = 0;
+    uint16_t name_size = 0;
+
+    // result, item count, then every entry with its decoded name.
+    for (index = 0; index < node->item_count; index++)
+    {
+        size = size + sizeof(fat_dir_t) + 2 + (uint32_t)strlen(node->items[index].name);
+    }
+    data = (uint8_t*)malloc(size);
+    if (data == NULL)
+    {
+        return;
+    }
+    memcpy(data, &result, 4);
+    memcpy(data + 4, &node->item_count, 4);
+    for (index = 0, item = data + 8; index < node->item_count; index++)
+    {
+        name_size = (uint16_t)strlen(node->items[index].name);
+        memcpy(item, &node->items[index].dir, sizeof(fat_dir_t));
+        memcpy(item + sizeof(fat_dir_t), &name_size, 2);
+        memcpy(item + sizeof(fat_dir_t) + 2, node->items[index].name, name_size);
+        item = item + sizeof(fat_dir_t) + 2 + name_size;
+    }
+    fat_side_put(fc->side_next, node->cluster, scan->hash_count, scan->hash, data, size);
+    free(data);
+}
+
+static int fat_dirs_reuse(fat_ck_t* fc, fat_dir_node_t* node, int* result)
+{
+    fat_side_rec_t* rec = fat_side_find(fc->side, node->cluster);
+    fat_dir_scan_t scan = { 0 };
+    fat_dir_t dir = { 0 };
+    char name[FAT_LFN_SIZE] = { 0 };
+    const uint8_t* item = NULL;
+    const uint8_t* end = NULL;
+    uint32_t cluster = node->cluster;
+    uint32_t size = fat_dirs_region(fc, cluster);
+    uint32_t index = 0;
+    uint32_t count = 0;
+    uint32_t items = 0;
+    uint16_t name_size = 0;
+    int cached = 0;
+
+    if ((rec == NULL) || (rec->size < 8) || (rec->count == 0))
+    {
+        return -1;
+    }
+    memcpy(&cached, rec->data, 4);
+    memcpy(&items, rec->data + 4, 4);
+    // the chain must still hold every hashed cluster, and no more when the parse ran off its end.
+    count = (cluster == 0) ? 1 : fat_fats_count(fc, cluster);
+    if ((rec->count > count) || ((cached < 0) && (rec->count != count)))
+    {
+        return -1;
+    }
+    // the cached entries must decode completely before any is used.
+    for (index = 0, item = rec->data + 8, end = rec->data + rec->size; index < items; index++)
+    {
+        if ((size_t)(end - item) < sizeof(fat_dir_t) + 2)
+        {
+            return -1;
+        }
+        memcpy(&name_size, item + sizeof(fat_dir_t), 2);
+        if ((name_size >= FAT_LFN_SIZE) || ((size_t)(end - item) < sizeof(fat_dir_t) + 2 + name_size))
+        {
+            return -1;
+        }
+        item = item + sizeof(fat_dir_t) + 2 + name_size;
+    }
+    scan.hash_buff = (uint8_t*)malloc(size);
+    if (cluster == 0)
+    {
+        fat_dirs_hash(fc, &scan, (uint64_t)fc->fatfs.root_sector_start * fc->device->sector_size, size);
+    }
+    for (index = 0; (cluster != 0) && (index < rec->count) && (scan.hash_buff != NULL); index++)
+    {
+        fat_dirs_hash(fc, &scan, fat_clus_addr(fc, cluster), size);
+        cluster = fat_link(fc, cluster);
+    }
+    free(scan.hash_buff);
+    if ((scan.hash_count != rec->count) || (scan.hash != rec->hash))
+    {
+        return -1;
+    }
+    for (index = 0, item = rec->data + 8; index < items; index++)
+    {
+        memcpy(&dir, item, sizeof(fat_dir_t));
+        memcpy(&name_size, item + sizeof(fat_dir_t), 2);
+        memcpy(name, item + sizeof(fat_dir_t) + 2, name_size);
+        name[name_size] = '\0';
+        fat_dirs_add(node, &dir, name);
+        item = item + sizeof(fat_dir_t) + 2 + name_size;
+    }
+    // carry the record over, the next sidecar holds only reachable directories.
+    fat_side_put(fc->side_next, rec->key, rec->count, rec->hash, rec->data, rec->size);
+    fat_atomic_add(&fc->dirs_reused, 1);
+    *result = cached;
+    return 0;
+}
+
+static int fat_dirs_chain(fat_ck_t* fc, fat_dir_node_t* node, fat_dir_scan_t* scan)
+{
+    int result = -1;
+    uint32_t index = 0;
+    uint32_t cluster = node->cluster;
+    uint32_t count = fat_fats_count(fc, cluster);
+    uint32_t clus_size = fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size;
+    uint64_t addrs = 0;
+    uint64_t start = 0;
+    fat_ra_t ra = { 0 };
+
+    // staged sweep runs need no readahead.
+    fat_ra_init(fc, &ra, cluster, (fc->run_count > 0) ? 0 : count);
+    // walk the directory cluster by cluster until its end entry.
+    for (index = 0; index < count; index++)
+    {
+        fat_ra_issue(fc, &ra);
+        start = fat_time_us();
+        addrs = fat_clus_addr(fc, cluster);
+        result = fat_dirs_check(fc, node, scan, addrs, addrs + clus_size);
+        fat_dirs_hash(fc, scan, addrs, clus_size);
+        scan->clusters = scan->clusters + 1;
+        if (result == 0)
+        {
+            break;
+        }
+        fat_ra_tune(&ra, (index > 0) ? (fat_time_us() - start) : 0);
+        cluster = fat_link(fc, cluster);
+    }
+    return result;
+}
+
+static int fat_dirs_parse(fat_ck_t* fc, fat_dir_node_t* node)
+{
+    int result = -1;
+    uint64_t root_start = 0;
+    uint64_t root_end = 0;
+    fat_dir_scan_t scan = { 0 };
+
+    // unchanged directories come from the last run's sidecar.
+    if ((fc->side != NULL) && (fat_dirs_reuse(fc, node, &result) == 0))
+    {
+        return result;
+    }
+    // long names may span clusters, the scan state lives for the whole directory.
+    scan.buff = (uint8_t*)malloc(fc->device->sector_size);
+    if (scan.buff == NULL)
+    {
+        printf("fat dir sector buffer malloc failed.\r\n");
+        return -1;
+    }
+    scan.hash_buff = (fc->side_next != NULL) ? (uint8_t*)malloc(fat_dirs_region(fc, node->cluster)) : NULL;
+    // cluster 0 is the FAT12/16 fixed root directory region.
+    if (node->cluster == 0)
+    {
+        root_start = ((uint64_t)fc->fatfs.root_sector_start * fc->device->sector_size);
+        root_end = (uint64_t)(fc->fatfs.root_sector_start + fc->fatfs.root_sector_count) * fc->device->sector_size;
+        result = fat_dirs_check(fc, node, &scan, root_start, root_end);
+        fat_dirs_hash(fc, &scan, root_start, (uint32_t)(root_end - root_start));
+    }
+    else
+    {
+        result = fat_dirs_chain(fc, node, &scan);
+    }
+    if (scan.hash_buff != NULL)
+    {
+        fat_dirs_store(fc, node, &scan, result);
+    }
+    if (fc->side_next != NULL)
+    {
+        fat_atomic_add(&fc->dirs_parsed, 1);
+    }
+    FAT_STAT_ADD(fc, dir_entries, scan.entries);
+    FAT_STAT_ADD(fc, clusters_visited, scan.clusters);
+    free(scan.hash_buff);
+    free(scan.buff);
+    return result;
+}
+
+static uint32_t fat_dirs_child(const fat_dir_t* dir)
+{
+    if (!(dir->DIR_Attr & ATTR_DIRECTORY) || (dir->DIR_FileSize != 0))
+    {
+        return 0;
+    }
+    return ((uint32_t)dir->DIR_FstClusHI << 16) | dir->DIR_FstClusLO;
+}
+
+static void fat_dirs_task(fat_pool_t* pool, int worker, void* arg)
+{
+    fat_ck_t* fc = (fat_ck_t*)pool->user;
+    fat_dir_node_t* node = (fat_dir_node_t*)arg;
+    fat_dir_node_t* child = NULL;
+    uint32_t index = 0;
+    uint32_t cluster = 0;
+
+    fat_dirs_parse(fc, node);
+    // every subdirectory becomes a stealable job.
+    for (index = 0; index < node->item_count; index++)
+    {
+        cluster = fat_dirs_child(&node->items[index].dir);
+        if (cluster == 0)
+        {
+            continue;
+        }
+        child = fat_dirs_claim(fc, cluster);
+        if ((child != NULL) && (fat_pool_push(pool, worker, fat_dirs_task, child) < 0))
+        {
+            fat_dirs_task(pool, worker, child);
+        }
+    }
+}
+
+static int fat_sweep_compare(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static int fat_sweep_stage(fat_ck_t* fc, uint32_t* clusters, uint32_t count, uint32_t root_size)
+{
+    uint32_t index = 0;
+    uint32_t used = 0;
+    uint32_t req_count = 0;
+    uint32_t clus_size = fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size;
+    fat_run_t* run = NULL;
+
+    // elevator order, then merge physically adjacent clusters into one read.
+    qsort(clusters, count, sizeof(uint32_t), fat_sweep_compare);
+    fc->run_count = 0;
+    if (root_size > 0)
+    {
+        run = &fc->runs[fc->run_count++];
+        run->addr = (uint64_t)fc->fatfs.root_sector_start * fc->device->sector_size;
+        run->size = root_size;
+    }
+    for (index = 0; index < count; index++)
+    {
+        if ((index > 0) && (clusters[index] == clusters[index - 1]))
+        {
+            continue;
+        }
+        if ((run != NULL) && (run->addr + run->size == fat_clus_addr(fc, clusters[index])))
+        {
+            run->size = run->size + clus_size;
+            continue;
+        }
+        run = &fc->runs[fc->run_count++];
+        run->addr = fat_clus_addr(fc, clusters[index]);
+        run->size = clus_size;
+    }
+    // one forward pass over the runs, in place when the device is mapped.
+    for (index = 0; index < fc->run_count; index++)
+    {
+        run = &fc->runs[index];
+        FAT_STAT_ADD(fc, bytes_read, run->size);
+        FAT_STAT_ADD(fc, read_calls, 1);
+        run->data = fat_dev_map(fc->device, run->addr, run->size);
+        if (run->data == NULL)
+        {
+            fc->io_reqs[req_count].offset = run->addr;
+            fc->io_reqs[req_count].buff = fc->sweep_buff + used;
+            fc->io_reqs[req_count].size = run->size;
+            fc->io_reqs[req_count].user = run;
+            run->data = fc->sweep_buff + used;
+            used = used + run->size;
+            req_count = req_count + 1;
+        }
+    }
+    // the whole batch is queued at once, reads complete in any order.
+    if ((req_count > 0) && (fat_io_read(fc->io, fc->io_reqs, req_count, NULL) < 0))
+    {
+        for (index = 0; index < req_count; index++)
+        {
+            if (fc->io_reqs[index].result != (int)fc->io_reqs[index].size)
+            {
+                fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat sweep read at 0x%08llX failed.", (unsigned long long)fc->io_reqs[index].offset);
+            }
+        }
+        fc->run_count = 0;
+        return -1;
+    }
+    return 0;
+}
+
+static int fat_sweep_walk(fat_ck_t* fc, fat_dir_node_t* root)
+{
+    fat_dir_node_t** level = NULL;
+    fat_dir_node_t** next = NULL;
+    fat_dir_node_t** nodes = NULL;
+    fat_dir_node_t* child = NULL;
+    uint32_t* clusters = NULL;
+    uint32_t level_count = 1;
+    uint32_t next_count = 0;
+    uint32_t next_limit = 0;
+    uint32_t grow = 0;
+    uint32_t clus_size = fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size;
+    uint32_t clus_limit = FAT_SWEEP_SIZE / clus_size;
+    uint32_t clus_count = 0;
+    uint32_t root_size = 0;
+    uint32_t first = 0;
+    uint32_t last = 0;
+    uint32_t index = 0;
+    uint32_t item = 0;
+    uint32_t cluster = 0;
+    uint32_t count = 0;
+
+    clus_limit = (clus_limit > 0) ? clus_limit : 1;
+    level = (fat_dir_node_t**)malloc(sizeof(fat_dir_node_t*));
+    clusters = (uint32_t*)malloc(clus_limit * sizeof(uint32_t));
+    fc->runs = (fat_run_t*)malloc((clus_limit + 1) * sizeof(fat_run_t));
+    fc->sweep_buff = (uint8_t*)malloc(FAT_SWEEP_SIZE + fc->fatfs.root_sector_count * fc->device->sector_size);
+    fc->io_reqs = (fat_io_req_t*)malloc((clus_limit + 1) * sizeof(fat_io_req_t));
+    fc->io = (fc->device->mode == FAT_DEV_MODE_READ) ? fat_io_create(fc->device, fc->io_depth, fc) : NULL;
+    if ((level == NULL) || (clusters == NULL) || (fc->runs == NULL) || (fc->sweep_buff == NULL) || (fc->io_reqs == NULL) ||
+        ((fc->device->mode == FAT_DEV_MODE_READ) && (fc->io == NULL)))
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat sweep malloc failed.");
+        free(level);
+        free(clusters);
+        return -1;
+    }
+    level[0] = root;
+    // breadth first, each level is read in batches of whole directories.
+    while (level_count > 0)
+    {
+        next_count = 0;
+        for (first = 0; first < level_count; first = last)
+        {
+            clus_count = 0;
+            root_size = 0;
+            for (last = first; last < level_count; last++)
+            {
+                if (level[last]->cluster == 0)
+                {
+                    root_size = fc->fatfs.root_sector_count * fc->device->sector_size;
+                    continue;
+                }
+                count = fat_fats_count(fc, level[last]->cluster);
+                if ((clus_count + count > clus_limit) && (last > first))
+                {
+                    break;
+                }
+                cluster = level[last]->cluster;
+                for (index = 0; (index < count) && (clus_count < clus_limit); index++)
+                {
+                    clusters[clus_count++] = cluster;
+                    cluster = fat_link(fc, cluster);
+                }
+            }
+            fat_sweep_stage(fc, clusters, clus_count, root_size);
+            for (index = first; index < last; index++)
+            {
+                fat_dirs_parse(fc, level[index]);
+                for (item = 0; item < level[index]->item_count; item++)
+                {
+                    cluster = fat_dirs_child(&level[index]->items[item].dir);
+                    child = (cluster != 0) ? fat_dirs_claim(fc, cluster) : NULL;
+                    if (child == NULL)
+                    {
+                        continue;
+                    }
+                    if (next_count >= next_limit)
+                    {
+                        // the limit grows only with the array, a failed realloc keeps both.
+                        grow = (next_limit == 0) ? 0x100 : (next_limit * 2);
+                        nodes = (fat_dir_node_t**)realloc(next, grow * sizeof(fat_dir_node_t*));
+                        if (nodes == NULL)
+                        {
+                            fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat sweep malloc failed.");
+                            continue;
+                        }
+                        next = nodes;
+                        next_limit = grow;
+                    }
+                    next[next_count++] = child;
+                }
+            }
+            fc->run_count = 0;
+        }
+        free(level);
+        level = next;
+        level_count = next_count;
+        next = NULL;
+        next_limit = 0;
+    }
+    free(level);
+    free(clusters);
+    return 0;
+}
+
+static char* fat_path_join(const char* parent, const char* name)
+{
+    size_t size = strlen(parent) + strlen(name) + 2;
+    char* path = (char*)malloc(size);
+    if (path != NULL)
+    {
+        snprintf(path, size, "%s/%s", parent, name);
+    }
+    return path;
+}
+
+// append a directory name to a growing path, the returned length cuts it back.
+static size_t fat_path_enter(char** path, size_t* limit, const char* name)
+{
+    size_t used = strlen(*path);
+    size_t size = used + strlen(name) + 2;
+    char* grow = NULL;
+    if (size > *limit)
+    {
+        grow = (char*)realloc(*path, size * 2);
+        if (grow == NULL)
+        {
+            // the subtree is listed under its parent path.
+            printf("fat path malloc failed.\r\n");
+            return used;
+        }
+        *path = grow;
+        *limit = size * 2;
+    }
+    snprintf(*path + used, size - used, "/%s", name);
+    return used;
+}
+
+static int fat_data_add(fat_ck_t* fc, const char* name, const fat_dir_t* dir, bool marked)
+{
+    uint32_t clus_size = fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size;
+    uint32_t need = (uint32_t)(((uint64_t)dir->DIR_FileSize + clus_size - 1) / clus_size);
+    uint32_t count = marked ? fc->chains[fc->chain_count - 1].count : 0;
+    fat_data_file_t* files = NULL;
+    fat_data_file_t* file = NULL;
+
+    if (fc->file_count >= fc->file_limit)
+    {
+        fc->file_limit = (fc->file_limit == 0) ? 0x400 : (fc->file_limit * 2);
+        files = (fat_data_file_t*)realloc(fc->files, fc->file_limit * sizeof(fat_data_file_t));
+        if (files == NULL)
+        {
+            fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat data file list malloc failed.");
+            return -1;
+        }
+        fc->files = files;
+    }
+    file = &fc->files[fc->file_count];
+    memset(file, 0, sizeof(fat_data_file_t));
+    file->path = fat_path_join(fc->data_path, name);
+    if (file->path == NULL)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat data path malloc failed.");
+        return -1;
+    }
+    file->cluster = ((uint32_t)dir->DIR_FstClusHI << 16) | dir->DIR_FstClusLO;
+    file->size = dir->DIR_FileSize;
+    fc->file_count = fc->file_count + 1;
+    // the chain finding is already reported, its content is not hashed.
+    if ((file->cluster != 0) && !marked)
+    {
+        file->state = FAT_DATA_BROKEN;
+        return 0;
+    }
+    if (count != need)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "data", "File %s: chain of %u clusters, size %u needs %u.", file->path, count, file->size, need);
+        fc->file_mismatch = fc->file_mismatch + 1;
+        fc->error = fc->error + 1;
+        // a longer chain still holds the whole file.
+        file->state = (count < need) ? FAT_DATA_SHORT : FAT_DATA_HASHED;
+    }
+    return 0;
+}
+
+static uint32_t fat_data_span(fat_ck_t* fc, uint32_t cluster, uint32_t left, uint32_t* next)
+{
+    uint32_t clus_size = fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size;
+    uint32_t need = (uint32_t)(((uint64_t)left + clus_size - 1) / clus_size);
+    uint32_t limit = (FAT_DATA_RUN > clus_size) ? (FAT_DATA_RUN / clus_size) : 1;
+    uint32_t run = fat_link_run(fc, cluster, next);
+    // an extent is read and hashed at once, up to the buffer size.
+    limit = (limit < need) ? limit : need;
+    *next = (run > limit) ? (cluster + limit) : *next;
+    run = (run < limit) ? run : limit;
+    return ((uint64_t)run * clus_size < left) ? (run * clus_size) : left;
+}
+
+static const uint8_t* fat_data_read(fat_ck_t* fc, int worker, uint64_t offset, uint32_t size)
+{
+    uint32_t clus_size = fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size;
+    const uint8_t* data = NULL;
+
+    FAT_STAT_ADD(fc, bytes_read, size);
+    FAT_STAT_ADD(fc, read_calls, 1);
+    data = fat_dev_map(fc->device, offset, size);
+    if (data != NULL)
+    {
+        return data;
+    }
+    // file content bypasses the block cache, it is read once.
+    if (fc->data_buffs[worker] == NULL)
+    {
+        fc->data_buffs[worker] = (uint8_t*)malloc(FAT_DATA_RUN + clus_size);
+    }
+    if ((fc->data_buffs[worker] == NULL) || (fat_dev_pread(fc->device, offset, fc->data_buffs[worker], size) != (int)size))
+    {
+        return NULL;
+    }
+    return fc->data_buffs[worker];
+}
+
+static void fat_data_task(fat_pool_t* pool, int worker, void* arg)
+{
+    fat_ck_t* fc = (fat_ck_t*)pool->user;
+    fat_data_file_t* file = (fat_data_file_t*)arg;
+    uint32_t cluster = file->cluster;
+    uint32_t left = file->size;
+    uint32_t size = 0;
+    uint32_t next = 0;
+    const uint8_t* data = NULL;
+
+    // the walk checked that the chain covers the file size.
+    while (left > 0)
+    {
+        size = fat_data_span(fc, cluster, left, &next);
+        // hint the following run while this one is hashed.
+        if (left > size)
+        {
+            fat_dev_advise(fc->device, fat_clus_addr(fc, next), ((left - size) < FAT_DATA_RUN) ? (left - size) : FAT_DATA_RUN);
+        }
+        data = fat_data_read(fc, worker, fat_clus_addr(fc, cluster), size);
+        if (data == NULL)
+        {
+            file->state = FAT_DATA_UNREAD;
+            return;
+        }
+        file->crc = fat_simd_crc32c(file->crc, data, size);
+        // the cluster size is only needed by the counter, FAT_STATS_DISABLE drops both.
+        FAT_STAT_ADD(fc, clusters_visited, (size + fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size - 1) / (fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size));
+        left = left - size;
+        cluster = next;
+    }
+}
+
+static int fat_data_write(fat_ck_t* fc)
+{
+    static const char* states[] = { "hashed", "broken", "short", "unread" };
+    FILE* file = NULL;
+    fat_data_file_t* item = NULL;
+    uint32_t index = 0;
+    uint32_t hashed = 0;
+    uint32_t unread = 0;
+    uint64_t bytes = 0;
+    bool failed = false;
+
+    file = fopen(fc->manifest, "wb");
+    if (file == NULL)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat manifest %s open failed.", fc->manifest);
+        return -1;
+    }
+    // one line per file in namespace order, diffable against a golden manifest.
+    for (index = 0; index < fc->file_count; index++)
+    {
+        item = &fc->files[index];
+        if (item->state == FAT_DATA_HASHED)
+        {
+            hashed = hashed + 1;
+            bytes = bytes + item->size;
+            failed = (fprintf(file, "%s\t%08x\n", item->path, item->crc) < 0) || failed;
+            continue;
+        }
+        if (item->state == FAT_DATA_UNREAD)
+        {
+            fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "data", "File %s: content read failed.", item->path);
+            unread = unread + 1;
+            fc->error = fc->error + 1;
+        }
+        failed = (fprintf(file, "%s\t%s\n", item->path, states[item->state]) < 0) || failed;
+    }
+    failed = (fclose(file) != 0) || failed;
+    fat_rep_text(&fc->rep, FAT_REP_SUMMARY, "\r\n");
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "data");
+    fat_rep_uint(&fc->rep, "files", "data_files %llu.\r\n", fc->file_count);
+    fat_rep_uint(&fc->rep, "hashed", "data_hashed %llu.\r\n", hashed);
+    fat_rep_uint(&fc->rep, "bytes", "data_bytes %llu.\r\n", bytes);
+    fat_rep_uint(&fc->rep, "size_mismatch", "data_size_mismatch %llu.\r\n", fc->file_mismatch);
+    fat_rep_uint(&fc->rep, "unread", "data_unread %llu.\r\n", unread);
+    fat_rep_str(&fc->rep, "crc", "data_crc %s.\r\n", fat_simd_crc_name());
+    fat_rep_end(&fc->rep);
+    if (failed)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat manifest %s write failed.", fc->manifest);
+        return -1;
+    }
+    return ((fc->file_mismatch > 0) || (unread > 0)) ? -1 : 0;
+}
+
+static int fat_data_run(fat_ck_t* fc)
+{
+    fat_pool_t* pool = NULL;
+    uint32_t index = 0;
+    int worker = 0;
+
+    pool = fat_pool_create(fc->threads, fc);
+    fc->data_buffs = (pool != NULL) ? (uint8_t**)calloc(pool->thread_count, sizeof(uint8_t*)) : NULL;
+    if (fc->data_buffs == NULL)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat data hashing create failed.");
+        fat_pool_free(pool);
+        return -1;
+    }
+    // every file is a stealable job, the manifest keeps the namespace order.
+    for (index = 0; index < fc->file_count; index++)
+    {
+        if ((fc->files[index].state == FAT_DATA_HASHED) && (fc->files[index].size > 0) &&
+            (fat_pool_push(pool, 0, fat_data_task, &fc->files[index]) < 0))
+        {
+            fat_data_task(pool, 0, &fc->files[index]);
+        }
+    }
+    fat_pool_run(pool);
+    for (worker = 0; worker < pool->thread_count; worker++)
+    {
+        free(fc->data_buffs[worker]);
+    }
+    free(fc->data_buffs);
+    fc->data_buffs = NULL;
+    fat_pool_free(pool);
+    return fat_data_write(fc);
+}
+
+static void fat_dirs_emit(fat_ck_t* fc, fat_dir_node_t* node)
+{
+    uint32_t index = 0;
+    uint32_t cluster = 0;
+    size_t used = 0;
+    bool marked = false;
+    fat_dir_t* dir = NULL;
+    fat_dir_node_t* child = NULL;
+    fat_ck_entry_t entry = { 0 };
+
+    // report entries in namespace order, identical for any thread count.
+    for (index = 0; index < node->item_count; index++)
+    {
+        dir = &node->items[index].dir;
+        // a summary run formats nothing per entry.
+        if (fat_rep_want(&fc->rep, FAT_REP_ENTRIES))
+        {
+            fat_rep_text(&fc->rep, FAT_REP_ENTRIES, "\r\n");
+            fat_rep_begin(&fc->rep, FAT_REP_ENTRIES, "entry");
+            fat_rep_str(&fc->rep, "name", "DIR_Name         : %s \r\n", node->items[index].name);
+            fat_rep_uint(&fc->rep, "attr", "DIR_Attr         : 0x%02llX \r\n", dir->DIR_Attr);
+            fat_rep_uint(&fc->rep, "nt_res", "DIR_NTRes        : 0x%02llX \r\n", dir->DIR_NTRes);
+            fat_rep_uint(&fc->rep, "crt_time_tenth", "DIR_CrtTimeTenth : %llu \r\n", dir->DIR_CrtTimeTenth);
+            fat_rep_uint(&fc->rep, "crt_time", "DIR_CrtTime      : %llu \r\n", dir->DIR_CrtTime);
+            fat_rep_uint(&fc->rep, "crt_date", "DIR_CrtDate      : %llu \r\n", dir->DIR_CrtDate);
+            fat_rep_uint(&fc->rep, "lst_acc_date", "DIR_LstAccDate   : %llu \r\n", dir->DIR_LstAccDate);
+            fat_rep_uint(&fc->rep, "fst_clus_hi", "DIR_FstClusHI    : %llu \r\n", dir->DIR_FstClusHI);
+            fat_rep_uint(&fc->rep, "wrt_time", "DIR_WrtTime      : %llu \r\n", dir->DIR_WrtTime);
+            fat_rep_uint(&fc->rep, "wrt_date", "DIR_WrtDate      : %llu \r\n", dir->DIR_WrtDate);
+            fat_rep_uint(&fc->rep, "fst_clus_lo", "DIR_FstClusLO    : %llu \r\n", dir->DIR_FstClusLO);
+            fat_rep_uint(&fc->rep, "file_size", "DIR_FileSize     : %llu \r\n", dir->DIR_FileSize);
+            fat_rep_end(&fc->rep);
+        }
+        if (fc->calls.entry != NULL)
+        {
+            entry.name = node->items[index].name;
+            entry.parent = node->cluster;
+            entry.cluster = ((uint32_t)dir->DIR_FstClusHI << 16) | dir->DIR_FstClusLO;
+            entry.size = dir->DIR_FileSize;
+            entry.attr = dir->DIR_Attr;
+            entry.wrt_time = dir->DIR_WrtTime;
+            entry.wrt_date = dir->DIR_WrtDate;
+            fc->calls.entry(fc->calls.user, &entry);
+        }
+        // claim the entry chain, walk into subdirectory only when it is intact.
+        cluster = ((uint32_t)dir->DIR_FstClusHI << 16) | dir->DIR_FstClusLO;
+        marked = (cluster != 0) && (fat_chain_mark(fc, cluster) == 0);
+        if ((fc->manifest != NULL) && !(dir->DIR_Attr & (ATTR_DIRECTORY | ATTR_VOLUME_ID)))
+        {
+            fat_data_add(fc, node->items[index].name, dir, marked);
+        }
+        if (!marked)
+        {
+            // a broken directory chain hides the owners below it.
+            fc->dirs_skipped = fc->dirs_skipped + ((fat_dirs_child(dir) != 0) ? 1 : 0);
+            continue;
+        }
+        if ((dir->DIR_Attr & ATTR_DIRECTORY) && (dir->DIR_FileSize == 0))
+        {
+            child = fat_dirs_find(fc, cluster);
+            if ((child != NULL) && (fc->manifest != NULL))
+            {
+                used = fat_path_enter(&fc->data_path, &fc->data_path_limit, node->items[index].name);
+                fat_dirs_emit(fc, child);
+                fc->data_path[used] = '\0';
+            }
+            else if (child != NULL)
+            {
+                fat_dirs_emit(fc, child);
+            }
+        }
+    }
+}
+
+static int fat_dirs_walk(fat_ck_t* fc, uint32_t cluster)
+{
+    fat_pool_t* pool = NULL;
+    fat_dir_node_t* root = NULL;
+
+    fc->dir_bucket_count = FAT_DIR_BUCKETS;
+    fc->dir_nodes = (fat_dir_node_t**)calloc(fc->dir_bucket_count, sizeof(fat_dir_node_t*));
+    root = (fc->dir_nodes != NULL) ? fat_dirs_claim(fc, cluster) : NULL;
+    if ((root != NULL) && fc->io_order)
+    {
+        // disk order mode reads each tree level in one forward sweep.
+        if (fat_sweep_walk(fc, root) < 0)
+        {
+            return -1;
+        }
+        fat_dirs_emit(fc, root);
+        return 0;
+    }
+    pool = (root != NULL) ? fat_pool_create(fc->threads, fc) : NULL;
+    if (pool == NULL)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat dir traversal create failed.");
+        return -1;
+    }
+    // parse the whole tree on the pool, then report it in order.
+    fat_pool_push(pool, 0, fat_dirs_task, root);
+    fat_pool_run(pool);
+    fat_pool_free(pool);
+    fat_dirs_emit(fc, root);
+    return 0;
+}
+
+static void fat_win_report(fat_ck_t* fc)
+{
+    static const char* modes[] = { "full", "runs", "paged" };
+    fat_win_t* win = &fc->win;
+
+    // what the cap saved against what it cost, FAT windows decoded again and whole FAT scans.
+    if (win->mode == FAT_WIN_RUNS)
+    {
+        win->used_bytes = win->fixed_bytes + (uint64_t)win->run_limit * sizeof(fat_win_run_t);
+    }
+    else if (win->mode == FAT_WIN_PAGED)
+    {
+        win->used_bytes = win->fixed_bytes + (uint64_t)win->slot_count * (FAT_WIN_PAGE * sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t));
+    }
+    fat_rep_text(&fc->rep, FAT_REP_SUMMARY, "\r\n");
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "window");
+    fat_rep_str(&fc->rep, "mode", "window_mode %s.\r\n", modes[win->mode]);
+    fat_rep_uint(&fc->rep, "cap", "window_cap %llu.\r\n", win->cap);
+    fat_rep_uint(&fc->rep, "full_bytes", "window_full_bytes %llu.\r\n", win->full_bytes);
+    fat_rep_uint(&fc->rep, "used_bytes", "window_used_bytes %llu.\r\n", win->used_bytes);
+    fat_rep_uint(&fc->rep, "state_bytes", "window_state_bytes %llu.\r\n", win->state_bytes);
+    fat_rep_uint(&fc->rep, "state_spilled", "window_state_spilled %llu.\r\n", win->state_spill ? 1 : 0);
+    fat_rep_uint(&fc->rep, "entries", "window_entries %llu.\r\n", win->entries);
+    fat_rep_uint(&fc->rep, "runs", "window_runs %llu.\r\n", win->run_count);
+    fat_rep_uint(&fc->rep, "slots", "window_slots %llu.\r\n", win->slot_count);
+    fat_rep_uint(&fc->rep, "slot_ways", "window_slot_ways %llu.\r\n", win->slot_ways);
+    fat_rep_uint(&fc->rep, "loads", "window_loads %llu.\r\n", win->loads);
+    fat_rep_uint(&fc->rep, "fat_passes", "window_fat_passes %llu.\r\n", win->passes);
+    fat_rep_end(&fc->rep);
+}
+
+static int fat_root_check(fat_ck_t* fc)
+{
+    int result = -1;
+    uint32_t BPB_FATSzxxx = 0;
+    uint32_t BPB_TotSecxx = 0;
+    uint64_t start = fat_time_us();
+    fat_bpb_t* bpb = &fc->fatfs.bpb;
+
+    BPB_FATSzxxx = (fc->fatfs.fat_type == FAT_TYPE_FAT32) ? bpb->BPB_FATSz32 : bpb->BPB_FATSz16;
+    BPB_TotSecxx = (fc->fatfs.fat_type == FAT_TYPE_FAT32) ? bpb->BPB_TotSec32 : bpb->BPB_TotSec16;
+
+    fc->fatfs.fats_sector_start = fc->device->part_start + bpb->BPB_RsvdSecCnt;
+    fc->fatfs.fats_sector_count = BPB_FATSzxxx * bpb->BPB_NumFATs;
+    fc->fatfs.root_sector_start = fc->fatfs.fats_sector_start + fc->fatfs.fats_sector_count;
+    fc->fatfs.root_sector_count = (32 * bpb->BPB_RootEntCnt + bpb->BPB_BytsPerSec - 1) / bpb->BPB_BytsPerSec;
+    fc->fatfs.data_sector_start = fc->fatfs.root_sector_start + fc->fatfs.root_sector_count;
+    fc->fatfs.data_sector_count = BPB_TotSecxx - (fc->fatfs.data_sector_start - fc->device->part_start);
+
+    fat_rep_text(&fc->rep, FAT_REP_SUMMARY, "\r\n");
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "region");
+    fat_rep_uint(&fc->rep, "fats_sector_start", "fats_sector_start %llu.\r\n", fc->fatfs.fats_sector_start);
+    fat_rep_uint(&fc->rep, "fats_sector_count", "fats_sector_count %llu.\r\n", fc->fatfs.fats_sector_count);
+    fat_rep_uint(&fc->rep, "root_sector_start", "root_sector_start %llu.\r\n", fc->fatfs.root_sector_start);
+    fat_rep_uint(&fc->rep, "root_sector_count", "root_sector_count %llu.\r\n", fc->fatfs.root_sector_count);
+    fat_rep_uint(&fc->rep, "data_sector_start", "data_sector_start %llu.\r\n", fc->fatfs.data_sector_start);
+    fat_rep_uint(&fc->rep, "data_sector_count", "data_sector_count %llu.\r\n", fc->fatfs.data_sector_count);
+    fat_rep_end(&fc->rep);
+    
+    // process fat table
+    result = fat_fats_load(fc);
+    if (result < 0)
+    {
+        return result;
+    }
+    fc->stats.time_fat_load = fat_time_us() - start;
+    start = fat_time_us();
+    result = fat_fats_check(fc);
+    if (result < 0)
+    {
+        return result;
+    }
+    result = fat_fats_mirror(fc);
+    if (result < 0)
+    {
+        return result;
+    }
+    result = fat_fats_fsinfo(fc);
+    if (result < 0)
+    {
+        return result;
+    }
+    fc->stats.time_fat_check = fat_time_us() - start;
+    start = fat_time_us();
+
+    // process fat root directory
+    if (fc->win.state_spill)
+    {
+        fc->state_map = fat_dev_spill(fc->win.state_bytes, &fc->win.state_hand);
+    }
+    else
+    {
+        fc->state_map = (uint8_t*)calloc((size_t)fc->win.state_bytes, sizeof(uint8_t));
+    }
+    if (fc->state_map == NULL)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat state map malloc failed.");
+        return -1;
+    }
+    // file paths are built while the tree is emitted.
+    if (fc->manifest != NULL)
+    {
+        fc->data_path_limit = 0x100;
+        fc->data_path = (char*)calloc(fc->data_path_limit, sizeof(char));
+        if (fc->data_path == NULL)
+        {
+            fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat data path malloc failed.");
+            return -1;
+        }
+    }
+    if (fc->fatfs.fat_type == FAT_TYPE_FAT32)
+    {
+        if ((fat_chain_mark(fc, bpb->BPB_RootClus) < 0) || (fat_dirs_walk(fc, bpb->BPB_RootClus) < 0))
+        {
+            fc->dirs_skipped = fc->dirs_skipped + 1;
+        }
+    }
+    else if (fat_dirs_walk(fc, 0) < 0)
+    {
+        fc->dirs_skipped = fc->dirs_skipped + 1;
+    }
+
+    fc->stats.time_dirs = fat_time_us() - start;
+    start = fat_time_us();
+
+    // process fat data
+    result = fat_lost_scan(fc);
+    if (result < 0)
+    {
+        return result;
+    }
+    fc->stats.time_lost = fat_time_us() - start;
+    start = fat_time_us();
+    result = fat_chain_owners(fc);
+    fc->stats.time_chains = fat_time_us() - start;
+
+    // process file contents
+    start = fat_time_us();
+    if ((fc->manifest != NULL) && (fat_data_run(fc) < 0))
+    {
+        result = -1;
+    }
+    fc->stats.time_data = fat_time_us() - start;
+    if (fc->win.cap > 0)
+    {
+        fat_win_report(fc);
+    }
+
+    return result;
+}
+
+static int fat_lost_slots(fat_ck_t* fc, uint64_t start, uint64_t end, uint64_t* slots, uint32_t* count, uint8_t* names)
+{
+    uint32_t sector_size = fc->device->sector_size;
+    uint32_t offset = 0;
+    uint32_t number = 0;
+    uint8_t* entry = NULL;
+
+    // collect free root slots, and the FOUND.nnn numbers already taken.
+    // every entry behind an end marker is free as well, filling one keeps the directory valid.
+    for (; start < end; start = start + sector_size)
+    {
+        if (fat_fix_peek(fc->fix, start, fc->sector_buffer, sector_size) != (int)sector_size)
+        {
+            fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat root directory read at 0x%08llX failed.", (unsigned long long)start);
+            return -1;
+        }
+        for (offset = 0; offset < sector_size; offset = offset + FAT_DIR_ENTRY_SIZE)
+        {
+            entry = fc->sector_buffer + offset;
+            if ((entry[0] == 0x00) || IS_DELETED_DIR(entry))
+            {
+                if (*count < fc->lost_count)
+                {
+                    slots[*count] = start + offset;
+                    *count = *count + 1;
+                }
+                continue;
+            }
+            if ((memcmp(entry, "FOUND   ", 8) == 0) && isdigit(entry[8]) && isdigit(entry[9]) && isdigit(entry[10]))
+            {
+                number = (entry[8] - '0') * 100 + (entry[9] - '0') * 10 + (entry[10] - '0');
+                FAT_BIT_SET(names, number);
+            }
+        }
+    }
+    return 0;
+}
+
+static int fat_lost_recover(fat_ck_t* fc)
+{
+    uint8_t names[(FAT_LOST_NAMES + 7) / 8] = { 0x00 };
+    uint8_t entry[FAT_DIR_ENTRY_SIZE] = { 0x00 };
+    uint64_t* slots = NULL;
+    uint64_t start = 0;
+    uint64_t size = 0;
+    uint64_t clus_size = (uint64_t)fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size;
+    uint32_t count = 0;
+    uint32_t index = 0;
+    uint32_t number = 0;
+    uint32_t cluster = fc->fatfs.bpb.BPB_RootClus;
+    uint32_t step = 0;
+    int result = 0;
+
+    slots = (uint64_t*)malloc(fc->lost_count * sizeof(uint64_t));
+    if (slots == NULL)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat lost slot list malloc failed.");
+        return -1;
+    }
+    // the fixed FAT12/16 root region, or the FAT32 root chain.
+    if (fc->fatfs.fat_type != FAT_TYPE_FAT32)
+    {
+        start = (uint64_t)fc->fatfs.root_sector_start * fc->device->sector_size;
+        result = fat_lost_slots(fc, start, start + (uint64_t)fc->fatfs.root_sector_count * fc->device->sector_size, slots, &count, names);
+    }
+    for (step = 0; (fc->fatfs.fat_type == FAT_TYPE_FAT32) && (step < fc->fat_entries) && (result == 0); step++)
+    {
+        start = fat_clus_addr(fc, cluster);
+        result = fat_lost_slots(fc, start, start + clus_size, slots, &count, names);
+        if (!FAT32_CLUS_USE(fc->fat_table[cluster]) || (fc->fat_table[cluster] >= fc->fat_entries))
+        {
+            break;
+        }
+        cluster = fc->fat_table[cluster];
+    }
+    // every lost chain becomes a root file, sized to its clusters.
+    for (index = 0; (index < fc->lost_count) && (index < count) && (result == 0); index++)
+    {
+        for (; (number < FAT_LOST_NAMES) && FAT_BIT_GET(names, number); number++);
+        if (number >= FAT_LOST_NAMES)
+        {
+            break;
+        }
+        size = (uint64_t)fc->lost[index].count * clus_size;
+        memset(entry, 0, sizeof(entry));
+        snprintf((char*)entry, sizeof(entry), "FOUND   %03u", number);
+        entry[DIR_ATTR] = ATTR_ARCHIVE;
+        entry[DIR_FST_CLUS_HI] = (uint8_t)(fc->lost[index].start >> 16);
+        entry[DIR_FST_CLUS_HI + 1] = (uint8_t)(fc->lost[index].start >> 24);
+        entry[DIR_FST_CLUS_LO] = (uint8_t)fc->lost[index].start;
+        entry[DIR_FST_CLUS_LO + 1] = (uint8_t)(fc->lost[index].start >> 8);
+        size = (size > 0xFFFFFFFF) ? 0xFFFFFFFF : size;
+        for (step = 0; step < 4; step++)
+        {
+            entry[DIR_FILE_SIZE + step] = (uint8_t)(size >> (step * 8));
+        }
+        result = fat_fix_patch(fc->fix, slots[index], entry, sizeof(entry));
+        FAT_BIT_SET(names, number);
+        fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "repair", "Repair [0x%08X]: lost chain saved as FOUND.%03u.", fc->lost[index].start, number);
+    }
+    if (index < fc->lost_count)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "repair", "Repair: %u lost chains kept, no free root entry or name.", fc->lost_count - index);
+    }
+    free(slots);
+    return result;
+}
+
+static int fat_repair_fsinfo(fat_ck_t* fc)
+{
+    fat_fs_t* fatfs = &fc->fatfs;
+    uint8_t* sector = fc->sector_buffer;
+    uint64_t fsinfo_addr = (uint64_t)(fc->device->part_start + fatfs->bpb.BPB_FSInfo) * fc->device->sector_size;
+    uint32_t index = 0;
+    uint32_t free_count = 0;
+    uint32_t next_free = FAT_FSINFO_UNKNOWN;
+
+    if ((fatfs->fat_type != FAT_TYPE_FAT32) || (fatfs->bpb.BPB_FSInfo == 0) || (fatfs->bpb.BPB_FSInfo >= fatfs->bpb.BPB_RsvdSecCnt))
+    {
+        return 0;
+    }
+    // recount after the FAT repairs, the check pass counted the old table.
+    for (index = 2; index < fc->fat_entries; index++)
+    {
+        if (FAT32_CLUS_FRE(fc->fat_table[index]))
+        {
+            next_free = (free_count == 0) ? index : next_free;
+            free_count = free_count + 1;
+        }
+    }
+    // an in range hint stays, unknown counters only change when the count does.
+    if ((fatfs->next_free == FAT_FSINFO_UNKNOWN) || ((fatfs->next_free >= 2) && (fatfs->next_free < fc->fat_entries)))
+    {
+        next_free = fatfs->next_free;
+    }
+    if (fatfs->fsinfo_valid && (fatfs->next_free == next_free) &&
+        ((fatfs->free_count == free_count) || ((fatfs->free_count == FAT_FSINFO_UNKNOWN) && (free_count == fc->clus_stat.free))))
+    {
+        return 0;
+    }
+    if (fat_fix_peek(fc->fix, fsinfo_addr, sector, fc->device->sector_size) != (int)fc->device->sector_size)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat repair FSInfo read failed.");
+        return -1;
+    }
+    memcpy(&sector[FAT_FSINFO_LEADSIG], "RRaA", 4);
+    memcpy(&sector[FAT_FSINFO_STRUCSIG], "rrAa", 4);
+    memcpy(&sector[FAT_FSINFO_TRAILSIG], "\x00\x00\x55\xAA", 4);
+    for (index = 0; index < 4; index++)
+    {
+        sector[FAT_FSINFO_FREECNT + index] = (uint8_t)(free_count >> (index * 8));
+        sector[FAT_FSINFO_NEXTFREE + index] = (uint8_t)(next_free >> (index * 8));
+    }
+    if (fat_fix_patch(fc->fix, fsinfo_addr, sector, fc->device->sector_size) < 0)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat repair FSInfo write failed.");
+        return -1;
+    }
+    fat_rep_note(&fc->rep, FAT_REP_FINDINGS, "repair", "Repair [FSInfo]: free count %u, next free %u.", free_count, next_free);
+    return 0;
+}
+
+static int fat_repair_run(fat_ck_t* fc)
+{
+    uint32_t patches = 0;
+    int result = 0;
+
+    result = (fc->lost_count > 0) ? fat_lost_recover(fc) : 0;
+    result = (result == 0) ? fat_repair_fsinfo(fc) : result;
+    // journal first, then the sorted and coalesced sector writes.
+    patches = fc->fix->patches;
+    result = (result == 0) ? fat_fix_commit(fc->fix, fc->journal) : result;
+    fat_rep_text(&fc->rep, FAT_REP_SUMMARY, "\r\n");
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "repair");
+    fat_rep_uint(&fc->rep, "patches", "repair_patches %llu.\r\n", patches);
+    fat_rep_uint(&fc->rep, "sectors", "repair_sectors %llu.\r\n", fc->fix->written);
+    fat_rep_uint(&fc->rep, "writes", "repair_writes %llu.\r\n", fc->fix->writes);
+    fat_rep_str(&fc->rep, "journal", "repair_journal %s.\r\n", fc->journal);
+    fat_rep_end(&fc->rep);
+    if (result < 0)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat repair commit failed.");
+    }
+    return result;
+}
+
+int fatck(const char* path, int sector_size)
+{
+    fat_ck_opts_t opts = { 0 };
+    opts.sector_size = sector_size;
+    opts.dev_mode = FAT_DEV_MODE_MMAP;
+    opts.threads = 0;
+    opts.io_order = false;
+    opts.queue_depth = FAT_IO_DEPTH_DEFAULT;
+    opts.report_format = FAT_REP_TEXT;
+    opts.report_level = FAT_REP_ENTRIES;
+    return fatck_opts(path, &opts);
+}
+
+static fat_ck_t* fat_ck_create(fat_dev_t* device, int threads)
+{
+    fat_ck_t *fc = (fat_ck_t*)calloc(1, sizeof(fat_ck_t));
+    if (fc == NULL)
+    {
+        printf("fat check object create failed.\r\n");
+        return NULL;
+    }
+    fc->device = device;
+    fc->threads = threads;
+    fat_mutex_init(&fc->dir_lock);
+    fat_mutex_init(&fc->win.lock);
+    return fc;
+}
+
+static int fat_side_open(fat_ck_t* fc)
+{
+    const uint8_t* boot = NULL;
+    uint64_t volume = 0;
+    uint32_t tag = (FAT_SIDE_VERSION << 16) | (uint32_t)sizeof(fat_dir_t);
+
+    // the boot sector names the volume, a reformatted image starts over.
+    boot = fat_ck_peek(fc, (uint64_t)fc->device->part_start * fc->device->sector_size, fc->sector_buffer, fc->device->sector_size);
+    if (boot == NULL)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat sidecar boot sector read failed.");
+        return -1;
+    }
+    volume = fat_hash64(boot, fc->device->sector_size, ((uint64_t)fc->device->part_start << 32) | fc->device->sector_size);
+    fc->side = fat_side_load(fc->side_path, volume, tag);
+    fc->side_next = fat_side_create(volume, tag);
+    if ((fc->side == NULL) || (fc->side_next == NULL))
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat sidecar %s load failed.", fc->side_path);
+        return -1;
+    }
+    return 0;
+}
+
+static void fat_side_close(fat_ck_t* fc)
+{
+    fat_rep_text(&fc->rep, FAT_REP_SUMMARY, "\r\n");
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "incremental");
+    fat_rep_uint(&fc->rep, "fat_sectors", "incremental_fat_sectors %llu.\r\n", fc->side_next->fat_count);
+    fat_rep_uint(&fc->rep, "fat_sectors_changed", "incremental_fat_sectors_changed %llu.\r\n", fc->fat_changed);
+    fat_rep_uint(&fc->rep, "dirs_reused", "incremental_dirs_reused %llu.\r\n", (uint64_t)fc->dirs_reused);
+    fat_rep_uint(&fc->rep, "dirs_parsed", "incremental_dirs_parsed %llu.\r\n", (uint64_t)fc->dirs_parsed);
+    fat_rep_end(&fc->rep);
+    fat_side_save(fc->side_next, fc->side_path);
+}
+
+static void fat_ck_stats(fat_ck_t* fc)
+{
+    fat_ck_stats_t* stats = &fc->stats;
+    fat_rep_text(&fc->rep, FAT_REP_SUMMARY, "\r\n");
+    fat_rep_begin(&fc->rep, FAT_REP_SUMMARY, "stats");
+    fat_rep_uint(&fc->rep, "bytes_read", "stats_bytes_read %llu.\r\n", stats->bytes_read);
+    fat_rep_uint(&fc->rep, "read_calls", "stats_read_calls %llu.\r\n", stats->read_calls);
+    fat_rep_uint(&fc->rep, "cache_hits", "stats_cache_hits %llu.\r\n", stats->cache_hits);
+    fat_rep_uint(&fc->rep, "cache_misses", "stats_cache_misses %llu.\r\n", stats->cache_misses);
+    fat_rep_uint(&fc->rep, "fat_entries", "stats_fat_entries %llu.\r\n", stats->fat_entries);
+    fat_rep_uint(&fc->rep, "dir_entries", "stats_dir_entries %llu.\r\n", stats->dir_entries);
+    fat_rep_uint(&fc->rep, "clusters_visited", "stats_clusters_visited %llu.\r\n", stats->clusters_visited);
+    fat_rep_uint(&fc->rep, "chain_extents", "stats_chain_extents %llu.\r\n", stats->chain_extents);
+    fat_rep_uint(&fc->rep, "chains_fragmented", "stats_chains_fragmented %llu.\r\n", stats->chains_fragmented);
+    fat_rep_uint(&fc->rep, "bpb_us", "stats_bpb_us %llu.\r\n", stats->time_bpb);
+    fat_rep_uint(&fc->rep, "fat_load_us", "stats_fat_load_us %llu.\r\n", stats->time_fat_load);
+    fat_rep_uint(&fc->rep, "fat_check_us", "stats_fat_check_us %llu.\r\n", stats->time_fat_check);
+    fat_rep_uint(&fc->rep, "dirs_us", "stats_dirs_us %llu.\r\n", stats->time_dirs);
+    fat_rep_uint(&fc->rep, "lost_us", "stats_lost_us %llu.\r\n", stats->time_lost);
+    fat_rep_uint(&fc->rep, "chains_us", "stats_chains_us %llu.\r\n", stats->time_chains);
+    fat_rep_uint(&fc->rep, "data_us", "stats_data_us %llu.\r\n", stats->time_data);
+    fat_rep_uint(&fc->rep, "repair_us", "stats_repair_us %llu.\r\n", stats->time_repair);
+    fat_rep_end(&fc->rep);
+}
+
+static void fat_ck_stats_add(fat_ck_stats_t* total, const fat_ck_stats_t* stats)
+{
+    total->bytes_read = total->bytes_read + stats->bytes_read;
+    total->read_calls = total->read_calls + stats->read_calls;
+    total->cache_hits = total->cache_hits + stats->cache_hits;
+    total->cache_misses = total->cache_misses + stats->cache_misses;
+    total->fat_entries = total->fat_entries + stats->fat_entries;
+    total->dir_entries = total->dir_entries + stats->dir_entries;
+    total->clusters_visited = total->clusters_visited + stats->clusters_visited;
+    total->chain_extents = total->chain_extents + stats->chain_extents;
+    total->chains_fragmented = total->chains_fragmented + stats->chains_fragmented;
+    total->time_bpb = total->time_bpb + stats->time_bpb;
+    total->time_fat_load = total->time_fat_load + stats->time_fat_load;
+    total->time_fat_check = total->time_fat_check + stats->time_fat_check;
+    total->time_dirs = total->time_dirs + stats->time_dirs;
+    total->time_lost = total->time_lost + stats->time_lost;
+    total->time_chains = total->time_chains + stats->time_chains;
+    total->time_data = total->time_data + stats->time_data;
+    total->time_repair = total->time_repair + stats->time_repair;
+}
+
+static int fat_ck_run(fat_ck_t* fc)
+{
+    int result = -1;
+    uint64_t start = fat_time_us();
+    result = fat_root_read(fc);
+    fc->stats.time_bpb = fat_time_us() - start;
+    if (result < 0)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat device root read failed.");
+        return result;
+    }
+    if ((fc->side_path != NULL) && (fat_side_open(fc) < 0))
+    {
+        return -1;
+    }
+    result = fat_root_check(fc);
+    if (result < 0)
+    {
+        fat_rep_note(&fc->rep, FAT_REP_SUMMARY, "error", "fat device root check failed.");
+    }
+    // repair needs the finished state map.
+    start = fat_time_us();
+    if ((fc->fix != NULL) && (fc->state_map != NULL) && (fat_repair_run(fc) < 0))
+    {
+        result = -1;
+    }
+    fc->stats.time_repair = fat_time_us() - start;
+    // a run that never reached the directory tree keeps the old sidecar.
+    if ((fc->side_next != NULL) && (fc->state_map != NULL))
+    {
+        fat_side_close(fc);
+    }
+    // the block cache only counts reads that went through it.
+    fc->stats.cache_hits = fc->device->cache.hits;
+    fc->stats.cache_misses = fc->device->cache.misses;
+    if (fc->stats_report)
+    {
+        fat_ck_stats(fc);
+    }
+    return result;
+}
+
+static void fat_ck_free(fat_ck_t* fc)
+{
+    uint32_t index = 0;
     fat_dev_close(fc->device);
     if (fc->device != NULL)
     {
-        free(fc->device);
+        free(fc->device);
+    }
+    if (fc->sector_buffer != NULL)
+    {
+        free(fc->sector_buffer);
+    }
+    if (fc->fat_table != NULL)
+    {
+        free(fc->fat_table);
+    }
+    if ((fc->state_map != NULL) && fc->win.state_spill)
+    {
+        fat_dev_unspill(fc->state_map, fc->win.state_bytes, fc->win.state_hand);
+    }
+    else if (fc->state_map != NULL)
+    {
+        free(fc->state_map);
+    }
+    free(fc->win.buff);
+    free(fc->win.free_bits);
+    free(fc->win.runs);
+    free(fc->win.slots);
+    free(fc->win.slot_page);
+    free(fc->win.slot_used);
+    free(fc->win.raw);
+    fat_mutex_free(&fc->win.lock);
+    if (fc->chains != NULL)
+    {
+        free(fc->chains);
+    }
+    if (fc->lost != NULL)
+    {
+        free(fc->lost);
+    }
+    fat_rep_free(&fc->rep);
+    fat_fix_free(fc->fix);
+    free(fc->journal);
+    fat_side_free(fc->side);
+    fat_side_free(fc->side_next);
+    free(fc->side_path);
+    for (index = 0; index < fc->file_count; index++)
+    {
+        free(fc->files[index].path);
+    }
+    free(fc->files);
+    free(fc->manifest);
+    free(fc->data_path);
+    if (fc->runs != NULL)
+    {
+        free(fc->runs);
+    }
+    if (fc->sweep_buff != NULL)
+    {
+        free(fc->sweep_buff);
+    }
+    if (fc->io_reqs != NULL)
+    {
+        free(fc->io_reqs);
+    }
+    fat_io_free(fc->io);
+    fat_dirs_free(fc);
+    fat_mutex_free(&fc->dir_lock);
+    free(fc);
+}
+
+static char* fat_ck_path(const char* path, const char* suffix)
+{
+    size_t size = strlen(path) + ((suffix != NULL) ? (strlen(suffix) + 1) : 0) + 1;
+    char* result = (char*)malloc(size);
+    if (result != NULL)
+    {
+        snprintf(result, size, (suffix != NULL) ? "%s.%s" : "%s", path, suffix);
+    }
+    return result;
+}
+
+static void fat_ck_device(fat_rep_t* rep, fat_dev_t* device, fat_io_t* io)
+{
+    if (device->mode == FAT_DEV_MODE_READ)
+    {
+        fat_rep_begin(rep, FAT_REP_SUMMARY, "cache");
+        fat_rep_uint(rep, "hits", "fat device cache hits %llu", device->cache.hits);
+        fat_rep_uint(rep, "misses", ", misses %llu", device->cache.misses);
+        fat_rep_uint(rep, "reads", ", reads %llu.\r\n", device->cache.reads);
+        fat_rep_end(rep);
+    }
+    if (io != NULL)
+    {
+        fat_rep_begin(rep, FAT_REP_SUMMARY, "io");
+        fat_rep_str(rep, "backend", "fat device io backend %s", fat_io_name(io));
+        fat_rep_uint(rep, "queue_depth", ", queue depth %llu.\r\n", io->depth);
+        fat_rep_end(rep);
+    }
+}
+
+fat_ck_t* fatck_open(const char* path, const fat_ck_opts_t* opts)
+{
+    fat_ck_t* fc = NULL;
+    fat_dev_t* device = fat_dev_open(path, opts->sector_size, opts->dev_mode | ((opts->journal != NULL) ? FAT_DEV_MODE_WRITE : 0));
+    if (device == NULL)
+    {
+        printf("fat device object open failed.\r\n");
+        return NULL;
+    }
+    fc = fat_ck_create(device, opts->threads);
+    if (fc == NULL)
+    {
+        fat_dev_close(device);
+        free(device);
+        return NULL;
+    }
+    // the options are copied, the caller may drop them after open.
+    if (opts->journal != NULL)
+    {
+        fc->fix = fat_fix_create(device, &fc->rep);
+        fc->journal = fat_ck_path(opts->journal, NULL);
+        if ((fc->fix == NULL) || (fc->journal == NULL))
+        {
+            fat_ck_free(fc);
+            return NULL;
+        }
+    }
+    fc->io_order = opts->io_order;
+    fc->io_depth = opts->queue_depth;
+    fc->stats_report = opts->stats;
+    fc->win.cap = opts->max_mem;
+    fc->side_path = (opts->sidecar != NULL) ? fat_ck_path(opts->sidecar, NULL) : NULL;
+    fc->manifest = (opts->manifest != NULL) ? fat_ck_path(opts->manifest, NULL) : NULL;
+    fat_rep_init(&fc->rep, opts->report_format, opts->report_level, stdout);
+    return fc;
+}
+
+void fatck_callbacks(fat_ck_t* fc, const fat_ck_callbacks_t* callbacks)
+{
+    memset(&fc->calls, 0, sizeof(fat_ck_callbacks_t));
+    if (callbacks != NULL)
+    {
+        fc->calls = *callbacks;
+    }
+    fc->rep.hook = fc->calls.finding;
+    fc->rep.hook_user = fc->calls.user;
+}
+
+int fatck_run(fat_ck_t* fc)
+{
+    // a context checks its volume once.
+    if (fc->done)
+    {
+        printf("fat check context has already run.\r\n");
+        return -1;
     }
-    if (fc->sector_buffer != NULL)
+    fc->done = true;
+    fc->result = fat_ck_run(fc);
+    fat_ck_device(&fc->rep, fc->device, fc->io);
+    fat_rep_flush(&fc->rep);
+    return fc->result;
+}
+
+int fatck_result(fat_ck_t* fc, fat_ck_result_t* result)
+{
+    if (!fc->done)
     {
-        free(fc->sector_buffer);
+        return -1;
     }
-    free(fc);
+    memset(result, 0, sizeof(fat_ck_result_t));
+    result->result = fc->result;
+    result->fat_type = fc->fatfs.fat_type;
+    result->errors = (uint32_t)fc->error;
+    result->chains = fc->chain_count;
+    result->cross_linked = fc->dup_count;
+    result->lost_chains = fc->lost_count;
+    result->lost_clusters = fc->lost_clusters;
+    result->dirs_skipped = fc->dirs_skipped;
+    result->stats = fc->stats;
+    return 0;
+}
+
+void fatck_close(fat_ck_t* fc)
+{
+    if (fc != NULL)
+    {
+        fat_ck_free(fc);
+    }
+}
+
+int fatck_opts(const char* path, const fat_ck_opts_t* opts)
+{
+    int result = -1;
+    fat_ck_t* fc = fatck_open(path, opts);
+    if (fc == NULL)
+    {
+        return result;
+    }
+    result = fatck_run(fc);
+    if (opts->stats_out != NULL)
+    {
+        *opts->stats_out = fc->stats;
+    }
+    fatck_close(fc);
+    return result;
+}
+
+static void fat_part_task(fat_pool_t* pool, int worker, void* arg)
+{
+    fat_ck_t* fc = (fat_ck_t*)arg;
+    (void)pool;
+    (void)worker;
+    fc->result = fat_ck_run(fc);
+}
+
+int fatck_layout(const char* path, const char* layout, const fat_ck_opts_t* opts)
+{
+    int result = 0;
+    uint32_t index = 0;
+    fat_layout_t* parts = NULL;
+    fat_dev_t* device = NULL;
+    fat_dev_t* view = NULL;
+    fat_ck_t** checks = NULL;
+    fat_pool_t* pool = NULL;
+    fat_part_t* part = NULL;
+    fat_rep_t rep = { 0 };
+
+    // partitions are checked side by side, one journal can not cover them.
+    if (opts->journal != NULL)
+    {
+        printf("fat repair is not supported with a partition layout.\r\n");
+        return -1;
+    }
+    parts = fat_layout_load(layout);
+    if (parts == NULL)
+    {
+        return -1;
+    }
+    if (opts->stats_out != NULL)
+    {
+        memset(opts->stats_out, 0, sizeof(fat_ck_stats_t));
+    }
+    device = fat_dev_open(path, opts->sector_size, opts->dev_mode);
+    checks = (fat_ck_t**)calloc(parts->part_count, sizeof(fat_ck_t*));
+    pool = fat_pool_create((opts->threads > 0) ? opts->threads : fat_cpu_count(), NULL);
+    if ((device == NULL) || (checks == NULL) || (pool == NULL))
+    {
+        printf("fat layout check create failed.\r\n");
+        fat_pool_free(pool);
+        free(checks);
+        if (device != NULL)
+        {
+            fat_dev_close(device);
+            free(device);
+        }
+        fat_layout_free(parts);
+        return -1;
+    }
+    // every partition is a window of the shared device, checked on its own pool task.
+    for (index = 0; index < parts->part_count; index++)
+    {
+        part = &parts->parts[index];
+        view = fat_dev_view(device, part->offset, part->length);
+        checks[index] = (view != NULL) ? fat_ck_create(view, 1) : NULL;
+        if (checks[index] == NULL)
+        {
+            free(view);
+            continue;
+        }
+        // partitions report into memory, printed in manifest order.
+        fat_rep_init(&checks[index]->rep, opts->report_format, opts->report_level, NULL);
+        checks[index]->io_order = opts->io_order;
+        checks[index]->io_depth = opts->queue_depth;
+        checks[index]->stats_report = opts->stats;
+        // the partitions run at once and share the cap.
+        checks[index]->win.cap = opts->max_mem / parts->part_count;
+        // one sidecar per partition, named after it.
+        checks[index]->side_path = (opts->sidecar != NULL) ? fat_ck_path(opts->sidecar, part->name) : NULL;
+        checks[index]->manifest = (opts->manifest != NULL) ? fat_ck_path(opts->manifest, part->name) : NULL;
+        fat_pool_push(pool, 0, fat_part_task, checks[index]);
+    }
+    fat_pool_run(pool);
+    // report partitions in manifest order.
+    fat_rep_init(&rep, opts->report_format, opts->report_level, stdout);
+    for (index = 0; index < parts->part_count; index++)
+    {
+        part = &parts->parts[index];
+        fat_rep_text(&rep, FAT_REP_SUMMARY, "\r\n");
+        fat_rep_begin(&rep, FAT_REP_SUMMARY, "partition");
+        fat_rep_str(&rep, "name", "Partition %s", part->name);
+        fat_rep_uint(&rep, "offset", " offset 0x%08llX", part->offset);
+        fat_rep_uint(&rep, "length", " length 0x%08llX.\r\n", part->length);
+        fat_rep_end(&rep);
+        if (checks[index] == NULL)
+        {
+            fat_rep_note(&rep, FAT_REP_SUMMARY, "error", "Partition %s open failed.", part->name);
+            result = -1;
+            continue;
+        }
+        fat_rep_write(&rep, checks[index]->rep.buff, checks[index]->rep.size);
+        fat_rep_begin(&rep, FAT_REP_SUMMARY, "partition_result");
+        fat_rep_str(&rep, "name", "Partition %s", part->name);
+        fat_rep_str(&rep, "result", " check %s.\r\n", (checks[index]->result < 0) ? "failed" : "passed");
+        fat_rep_end(&rep);
+        result = (checks[index]->result < 0) ? -1 : result;
+        // layout stats are the sum over the partitions.
+        if (opts->stats_out != NULL)
+        {
+            fat_ck_stats_add(opts->stats_out, &checks[index]->stats);
+        }
+        fat_ck_free(checks[index]);
+    }
+    fat_ck_device(&rep, device, NULL);
+    fat_rep_free(&rep);
+    fat_pool_free(pool);
+    free(checks);
+    fat_dev_close(device);
+    free(device);
+    fat_layout_free(parts);
+    return result;
+}
+
+static int fat_diff_order(const void* a, const void* b)
+{
+    return strcmp((*(const fat_dir_item_t* const*)a)->name, (*(const fat_dir_item_t* const*)b)->name);
+}
+
+static fat_dir_item_t** fat_diff_sorted(fat_dir_node_t* node, uint32_t* count)
+{
+    fat_dir_item_t** items = NULL;
+    uint32_t index = 0;
+
+    *count = 0;
+    if ((node == NULL) || (node->item_count == 0))
+    {
+        return NULL;
+    }
+    items = (fat_dir_item_t**)malloc(node->item_count * sizeof(fat_dir_item_t*));
+    if (items == NULL)
+    {
+        printf("fat diff item list malloc failed.\r\n");
+        return NULL;
+    }
+    // directory order differs between images, entries are paired by name.
+    for (index = 0; index < node->item_count; index++)
+    {
+        if (!(node->items[index].dir.DIR_Attr & ATTR_VOLUME_ID))
+        {
+            items[*count] = &node->items[index];
+            *count = *count + 1;
+        }
+    }
+    qsort(items, *count, sizeof(fat_dir_item_t*), fat_diff_order);
+    return items;
+}
+
+static int fat_diff_add(fat_diff_t* diff, const char* name, uint32_t change, uint32_t reason, const fat_dir_t* left, const fat_dir_t* right)
+{
+    fat_diff_item_t* items = NULL;
+    fat_diff_item_t* item = NULL;
+
+    if (diff->item_count >= diff->item_limit)
+    {
+        diff->item_limit = (diff->item_limit == 0) ? 0x100 : (diff->item_limit * 2);
+        items = (fat_diff_item_t*)realloc(diff->items, diff->item_limit * sizeof(fat_diff_item_t));
+        if (items == NULL)
+        {
+            printf("fat diff list malloc failed.\r\n");
+            return -1;
+        }
+        diff->items = items;
+    }
+    item = &diff->items[diff->item_count];
+    memset(item, 0, sizeof(fat_diff_item_t));
+    item->path = fat_path_join(diff->path, name);
+    if (item->path == NULL)
+    {
+        printf("fat diff path malloc failed.\r\n");
+        return -1;
+    }
+    item->change = change;
+    item->reason = reason;
+    if (left != NULL)
+    {
+        item->left = *left;
+    }
+    if (right != NULL)
+    {
+        item->right = *right;
+    }
+    diff->item_count = diff->item_count + 1;
+    return 0;
+}
+
+static void fat_diff_tree(fat_diff_t* diff, fat_ck_t* fc, const fat_dir_item_t* item, uint32_t change)
+{
+    fat_dir_node_t* node = NULL;
+    uint32_t cluster = fat_dirs_child(&item->dir);
+    uint32_t index = 0;
+    size_t used = 0;
+
+    fat_diff_add(diff, item->name, change, 0, (change == FAT_DIFF_REMOVED) ? &item->dir : NULL, (change == FAT_DIFF_ADDED) ? &item->dir : NULL);
+    node = (cluster != 0) ? fat_dirs_find(fc, cluster) : NULL;
+    // a whole subtree is added or removed, every entry below is listed.
+    if ((node == NULL) || node->visited)
+    {
+        return;
+    }
+    node->visited = true;
+    used = fat_path_enter(&diff->path, &diff->path_limit, item->name);
+    for (index = 0; index < node->item_count; index++)
+    {
+        if (!(node->items[index].dir.DIR_Attr & ATTR_VOLUME_ID))
+        {
+            fat_diff_tree(diff, fc, &node->items[index], change);
+        }
+    }
+    diff->path[used] = '\0';
+}
+
+static bool fat_diff_chain(fat_ck_t* fc, uint32_t cluster, uint32_t size)
+{
+    uint32_t clus_size = fc->fatfs.bpb.BPB_SecPerClus * fc->device->sector_size;
+    uint32_t need = (uint32_t)(((uint64_t)size + clus_size - 1) / clus_size);
+    uint32_t step = 0;
+
+    // the file size must be covered by in range clusters.
+    for (step = 0; step < need; step++)
+    {
+        if ((cluster < 2) || (cluster >= fc->fat_entries))
+        {
+            return false;
+        }
+        if (step + 1 < need)
+        {
+            cluster = fat_link(fc, cluster);
+            if (!FAT32_CLUS_USE(cluster))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool fat_diff_same_map(fat_diff_t* diff, const fat_dir_t* left, const fat_dir_t* right)
+{
+    uint32_t clus_size = diff->left->fatfs.bpb.BPB_SecPerClus * diff->left->device->sector_size;
+    uint32_t need = (uint32_t)(((uint64_t)left->DIR_FileSize + clus_size - 1) / clus_size);
+    uint32_t lclus = ((uint32_t)left->DIR_FstClusHI << 16) | left->DIR_FstClusLO;
+    uint32_t rclus = ((uint32_t)right->DIR_FstClusHI << 16) | right->DIR_FstClusLO;
+    uint32_t step = 0;
+
+    if ((clus_size != diff->right->fatfs.bpb.BPB_SecPerClus * diff->right->device->sector_size) ||
+        (diff->left->fatfs.first_data_sector != diff->right->fatfs.first_data_sector))
+    {
+        return false;
+    }
+    // equal up to where both chains break, a chain broken alike in both images is unchanged.
+    for (step = 0; step < need; step++)
+    {
+        if (lclus != rclus)
+        {
+            return false;
+        }
+        if ((lclus < 2) || (lclus >= diff->left->fat_entries) || (lclus >= diff->right->fat_entries))
+        {
+            break;
+        }
+        lclus = fat_link(diff->left, lclus);
+        rclus = fat_link(diff->right, rclus);
+    }
+    return true;
+}
+
+static void fat_diff_file(fat_diff_t* diff, const fat_dir_item_t* left, const fat_dir_item_t* right)
+{
+    const fat_dir_t* ldir = &left->dir;
+    const fat_dir_t* rdir = &right->dir;
+    uint32_t reason = 0;
+
+    reason = reason | ((ldir->DIR_FileSize != rdir->DIR_FileSize) ? FAT_DIFF_SIZE : 0);
+    reason = reason | ((ldir->DIR_Attr != rdir->DIR_Attr) ? FAT_DIFF_ATTR : 0);
+    reason = reason | (((ldir->DIR_WrtTime != rdir->DIR_WrtTime) || (ldir->DIR_WrtDate != rdir->DIR_WrtDate)) ? FAT_DIFF_TIME : 0);
+    // a size change needs no content read.
+    if (reason & FAT_DIFF_SIZE)
+    {
+        fat_diff_add(diff, left->name, FAT_DIFF_MODIFIED, reason, ldir, rdir);
+        return;
+    }
+    // same metadata over the same clusters is taken as unchanged without reading it.
+    if ((reason == 0) && fat_diff_same_map(diff, ldir, rdir))
+    {
+        diff->unchanged = diff->unchanged + 1;
+        return;
+    }
+    if (!fat_diff_chain(diff->left, ((uint32_t)ldir->DIR_FstClusHI << 16) | ldir->DIR_FstClusLO, ldir->DIR_FileSize) ||
+        !fat_diff_chain(diff->right, ((uint32_t)rdir->DIR_FstClusHI << 16) | rdir->DIR_FstClusLO, rdir->DIR_FileSize))
+    {
+        fat_diff_add(diff, left->name, FAT_DIFF_MODIFIED, reason | FAT_DIFF_CHAIN, ldir, rdir);
+        return;
+    }
+    fat_diff_add(diff, left->name, FAT_DIFF_COMPARE, reason, ldir, rdir);
+}
+
+static void fat_diff_dirs(fat_diff_t* diff, fat_dir_node_t* left, fat_dir_node_t* right)
+{
+    fat_dir_item_t** litems = NULL;
+    fat_dir_item_t** ritems = NULL;
+    uint32_t lcount = 0;
+    uint32_t rcount = 0;
+    uint32_t lindex = 0;
+    uint32_t rindex = 0;
+    uint32_t lchild = 0;
+    uint32_t rchild = 0;
+    size_t used = 0;
+    int order = 0;
+
+    // a directory loop is paired once.
+    if (((left != NULL) && left->visited) || ((right != NULL) && right->visited))
+    {
+        return;
+    }
+    if (left != NULL)
+    {
+        left->visited = true;
+    }
+    if (right != NULL)
+    {
+        right->visited = true;
+    }
+    litems = fat_diff_sorted(left, &lcount);
+    ritems = fat_diff_sorted(right, &rcount);
+    while ((lindex < lcount) || (rindex < rcount))
+    {
+        order = (lindex >= lcount) ? 1 : ((rindex >= rcount) ? -1 : strcmp(litems[lindex]->name, ritems[rindex]->name));
+        if (order < 0)
+        {
+            fat_diff_tree(diff, diff->left, litems[lindex++], FAT_DIFF_REMOVED);
+            continue;
+        }
+        if (order > 0)
+        {
+            fat_diff_tree(diff, diff->right, ritems[rindex++], FAT_DIFF_ADDED);
+            continue;
+        }
+        lchild = fat_dirs_child(&litems[lindex]->dir);
+        rchild = fat_dirs_child(&ritems[rindex]->dir);
+        if (((litems[lindex]->dir.DIR_Attr ^ ritems[rindex]->dir.DIR_Attr) & ATTR_DIRECTORY) != 0)
+        {
+            // a file replaced by a directory, or the other way round.
+            fat_diff_tree(diff, diff->left, litems[lindex], FAT_DIFF_REMOVED);
+            fat_diff_tree(diff, diff->right, ritems[rindex], FAT_DIFF_ADDED);
+        }
+        else if (litems[lindex]->dir.DIR_Attr & ATTR_DIRECTORY)
+        {
+            used = fat_path_enter(&diff->path, &diff->path_limit, litems[lindex]->name);
+            fat_diff_dirs(diff, (lchild != 0) ? fat_dirs_find(diff->left, lchild) : NULL, (rchild != 0) ? fat_dirs_find(diff->right, rchild) : NULL);
+            diff->path[used] = '\0';
+        }
+        else
+        {
+            fat_diff_file(diff, litems[lindex], ritems[rindex]);
+        }
+        lindex = lindex + 1;
+        rindex = rindex + 1;
+    }
+    free(litems);
+    free(ritems);
+}
+
+static const uint8_t* fat_diff_read(fat_ck_t* fc, uint32_t cluster, uint8_t* buff, uint32_t size)
+{
+    uint64_t offset = fat_clus_addr(fc, cluster);
+    const uint8_t* data = NULL;
+
+    FAT_STAT_ADD(fc, bytes_read, size);
+    FAT_STAT_ADD(fc, read_calls, 1);
+    data = fat_dev_map(fc->device, offset, size);
+    if (data != NULL)
+    {
+        return data;
+    }
+    if (fat_dev_pread(fc->device, offset, buff, size) != (int)size)
+    {
+        return NULL;
+    }
+    return buff;
+}
+
+static void fat_diff_task(fat_pool_t* pool, int worker, void* arg)
+{
+    fat_diff_t* diff = (fat_diff_t*)pool->user;
+    fat_diff_item_t* item = (fat_diff_item_t*)arg;
+    uint32_t lclus = ((uint32_t)item->left.DIR_FstClusHI << 16) | item->left.DIR_FstClusLO;
+    uint32_t rclus = ((uint32_t)item->right.DIR_FstClusHI << 16) | item->right.DIR_FstClusLO;
+    uint32_t lnext = 0;
+    uint32_t rnext = 0;
+    uint32_t lspan = 0;
+    uint32_t rspan = 0;
+    uint32_t loff = 0;
+    uint32_t roff = 0;
+    uint32_t left = item->left.DIR_FileSize;
+    uint32_t size = 0;
+    const uint8_t* ldata = NULL;
+    const uint8_t* rdata = NULL;
+
+    if (diff->buffs[worker] == NULL)
+    {
+        diff->buffs[worker] = (uint8_t*)malloc((size_t)FAT_DATA_RUN * 2);
+    }
+    if (diff->buffs[worker] == NULL)
+    {
+        item->reason = item->reason | FAT_DIFF_READ;
+        return;
+    }
+    // walk both chains extent by extent, the images may use different cluster sizes.
+    while (left > 0)
+    {
+        if (ldata == NULL)
+        {
+            lspan = fat_data_span(diff->left, lclus, left, &lnext);
+            ldata = fat_diff_read(diff->left, lclus, diff->buffs[worker], lspan);
+        }
+        if (rdata == NULL)
+        {
+            rspan = fat_data_span(diff->right, rclus, left, &rnext);
+            rdata = fat_diff_read(diff->right, rclus, diff->buffs[worker] + FAT_DATA_RUN, rspan);
+        }
+        if ((ldata == NULL) || (rdata == NULL))
+        {
+            item->reason = item->reason | FAT_DIFF_READ;
+            return;
+        }
+        size = ((lspan - loff) < (rspan - roff)) ? (lspan - loff) : (rspan - roff);
+        size = (size < left) ? size : left;
+        fat_atomic_add64(&diff->compared, size);
+        // the first differing byte ends the file.
+        if (fat_simd_compare(ldata + loff, rdata + roff, size) != size)
+        {
+            item->reason = item->reason | FAT_DIFF_DATA;
+            return;
+        }
+        loff = loff + size;
+        roff = roff + size;
+        left = left - size;
+        if (loff == lspan)
+        {
+            lclus = lnext;
+            loff = 0;
+            ldata = NULL;
+        }
+        if (roff == rspan)
+        {
+            rclus = rnext;
+            roff = 0;
+            rdata = NULL;
+        }
+    }
+}
+
+static int fat_diff_compare(fat_diff_t* diff)
+{
+    fat_pool_t* pool = NULL;
+    uint32_t index = 0;
+    int worker = 0;
+
+    pool = fat_pool_create(diff->threads, diff);
+    diff->buffs = (pool != NULL) ? (uint8_t**)calloc(pool->thread_count, sizeof(uint8_t*)) : NULL;
+    if (diff->buffs == NULL)
+    {
+        printf("fat diff compare create failed.\r\n");
+        fat_pool_free(pool);
+        return -1;
+    }
+    for (index = 0; index < diff->item_count; index++)
+    {
+        if ((diff->items[index].change == FAT_DIFF_COMPARE) && (diff->items[index].left.DIR_FileSize > 0) &&
+            (fat_pool_push(pool, 0, fat_diff_task, &diff->items[index]) < 0))
+        {
+            fat_diff_task(pool, 0, &diff->items[index]);
+        }
+    }
+    fat_pool_run(pool);
+    for (worker = 0; worker < pool->thread_count; worker++)
+    {
+        free(diff->buffs[worker]);
+    }
+    free(diff->buffs);
+    diff->buffs = NULL;
+    fat_pool_free(pool);
+    return 0;
+}
+
+static void fat_diff_report(fat_diff_t* diff, fat_rep_t* rep)
+{
+    static const char* changes[] = { "added", "removed", "modified", "modified" };
+    static const char* reasons[] = { "size", "attr", "time", "data", "chain", "read" };
+    fat_diff_item_t* item = NULL;
+    uint32_t counts[3] = { 0 };
+    uint32_t compared = 0;
+    uint32_t index = 0;
+    uint32_t bit = 0;
+    char reason[0x40] = { 0 };
+
+    // changes in namespace order of the right image, then the totals.
+    for (index = 0; index < diff->item_count; index++)
+    {
+        item = &diff->items[index];
+        compared = compared + ((item->change == FAT_DIFF_COMPARE) ? 1 : 0);
+        // equal content under new clusters.
+        if ((item->change == FAT_DIFF_COMPARE) && (item->reason == 0))
+        {
+            diff->unchanged = diff->unchanged + 1;
+            continue;
+        }
+        counts[(item->change == FAT_DIFF_COMPARE) ? FAT_DIFF_MODIFIED : item->change]++;
+        reason[0] = '\0';
+        for (bit = 0; bit < sizeof(reasons) / sizeof(reasons[0]); bit++)
+        {
+            if (item->reason & (1 << bit))
+            {
+                snprintf(reason + strlen(reason), sizeof(reason) - strlen(reason), "%s%s", (reason[0] != '\0') ? "," : "", reasons[bit]);
+            }
+        }
+        fat_rep_begin(rep, FAT_REP_FINDINGS, "diff_entry");
+        fat_rep_str(rep, "change", "%s ", changes[item->change]);
+        fat_rep_str(rep, "path", (reason[0] != '\0') ? "%s" : "%s.\r\n", item->path);
+        if (reason[0] != '\0')
+        {
+            fat_rep_str(rep, "reason", ": %s.\r\n", reason);
+        }
+        fat_rep_end(rep);
+    }
+    fat_rep_text(rep, FAT_REP_SUMMARY, "\r\n");
+    fat_rep_begin(rep, FAT_REP_SUMMARY, "diff");
+    fat_rep_uint(rep, "added", "diff_added %llu.\r\n", counts[FAT_DIFF_ADDED]);
+    fat_rep_uint(rep, "removed", "diff_removed %llu.\r\n", counts[FAT_DIFF_REMOVED]);
+    fat_rep_uint(rep, "modified", "diff_modified %llu.\r\n", counts[FAT_DIFF_MODIFIED]);
+    fat_rep_uint(rep, "unchanged", "diff_unchanged %llu.\r\n", diff->unchanged);
+    fat_rep_uint(rep, "content_compared", "diff_content_compared %llu.\r\n", compared);
+    fat_rep_uint(rep, "bytes_compared", "diff_bytes_compared %llu.\r\n", diff->compared);
+    fat_rep_end(rep);
+    diff->changed = counts[FAT_DIFF_ADDED] + counts[FAT_DIFF_REMOVED] + counts[FAT_DIFF_MODIFIED];
+}
+
+static uint32_t fat_diff_root(fat_ck_t* fc)
+{
+    return (fc->fatfs.fat_type == FAT_TYPE_FAT32) ? fc->fatfs.bpb.BPB_RootClus : 0;
+}
+
+int fatck_diff(const char* left, const char* right, const fat_ck_opts_t* opts)
+{
+    int result = -1;
+    uint32_t index = 0;
+    fat_ck_opts_t check = *opts;
+    fat_diff_t diff = { 0 };
+    fat_pool_t* pool = NULL;
+    fat_rep_t rep = { 0 };
+
+    // both images are checked quietly, only the differences are reported.
+    check.report_level = FAT_REP_NONE;
+    check.journal = NULL;
+    check.sidecar = NULL;
+    check.manifest = NULL;
+    check.stats = false;
+    check.stats_out = NULL;
+    // both images are held at once, each gets half the cap.
+    check.max_mem = opts->max_mem / 2;
+    diff.left = fatck_open(left, &check);
+    diff.right = fatck_open(right, &check);
+    pool = fat_pool_create(2, NULL);
+    diff.threads = opts->threads;
+    diff.path_limit = 0x100;
+    diff.path = (char*)calloc(diff.path_limit, sizeof(char));
+    if ((diff.left == NULL) || (diff.right == NULL) || (pool == NULL) || (diff.path == NULL))
+    {
+        printf("fat diff create failed.\r\n");
+        fat_pool_free(pool);
+        fatck_close(diff.left);
+        fatck_close(diff.right);
+        free(diff.path);
+        return -1;
+    }
+    fat_pool_push(pool, 0, fat_part_task, diff.left);
+    fat_pool_push(pool, 0, fat_part_task, diff.right);
+    fat_pool_run(pool);
+    fat_pool_free(pool);
+    fat_rep_init(&rep, opts->report_format, opts->report_level, stdout);
+    fat_rep_begin(&rep, FAT_REP_SUMMARY, "diff_images");
+    fat_rep_str(&rep, "left", "Diff %s", left);
+    fat_rep_str(&rep, "right", " against %s.\r\n", right);
+    fat_rep_end(&rep);
+    // a tree that was never walked can not be paired.
+    if ((diff.left->state_map == NULL) || (diff.right->state_map == NULL))
+    {
+        fat_rep_note(&rep, FAT_REP_SUMMARY, "error", "fat diff image %s check failed.", (diff.left->state_map == NULL) ? left : right);
+    }
+    else
+    {
+        if ((diff.left->result < 0) || (diff.right->result < 0))
+        {
+            fat_rep_note(&rep, FAT_REP_FINDINGS, "diff", "Image %s has check errors, files on broken chains show as modified.", (diff.left->result < 0) ? left : right);
+        }
+        fat_diff_dirs(&diff, fat_dirs_find(diff.left, fat_diff_root(diff.left)), fat_dirs_find(diff.right, fat_diff_root(diff.right)));
+        if (fat_diff_compare(&diff) == 0)
+        {
+            fat_diff_report(&diff, &rep);
+            // 1 when the images differ, like diff itself.
+            result = (diff.changed > 0) ? 1 : 0;
+        }
+    }
+    fat_rep_free(&rep);
+    for (index = 0; index < diff.item_count; index++)
+    {
+        free(diff.items[index].path);
+    }
+    free(diff.items);
+    free(diff.path);
+    fatck_close(diff.left);
+    fatck_close(diff.right);
+    return result;
+}
+
+int fatck_undo(const char* path, const char* journal, int sector_size)
+{
+    int result = -1;
+    fat_dev_t* device = fat_dev_open(path, sector_size, FAT_DEV_MODE_READ | FAT_DEV_MODE_WRITE);
+    if (device == NULL)
+    {
+        printf("fat device object open failed.\r\n");
+        return result;
+    }
+    result = fat_fix_undo(device, journal);
+    if (result < 0)
+    {
+        printf("fat undo from %s failed.\r\n", journal);
+    }
+    else
+    {
+        printf("fat undo restored %d sectors from %s.\r\n", result, journal);
+        result = 0;
+    }
+    fat_dev_close(device);
+    free(device);
     return result;
 }
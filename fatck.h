@@ -3,7 +3,117 @@
 #define __FATCK_H__
 
 #include "fatdev.h"
+#include "fatsimd.h"
+#include "fatpart.h"
+#include "fatio.h"
+#include "fatrep.h"
+#include "fatfix.h"
+#include "fathash.h"
+#include <stdarg.h>
+
+// counters and phase times of one check, counters stay 0 when built with FAT_STATS_DISABLE.
+typedef struct fat_ck_stats
+{
+    uint64_t bytes_read;
+    uint64_t read_calls;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t fat_entries;
+    uint64_t dir_entries;
+    uint64_t clusters_visited;
+    // extents of the claimed chains, and chains made of more than one.
+    uint64_t chain_extents;
+    uint64_t chains_fragmented;
+    // phase wall times in microseconds.
+    uint64_t time_bpb;
+    uint64_t time_fat_load;
+    uint64_t time_fat_check;
+    uint64_t time_dirs;
+    uint64_t time_lost;
+    uint64_t time_chains;
+    uint64_t time_data;
+    uint64_t time_repair;
+} fat_ck_stats_t;
+
+typedef struct fat_ck_opts
+{
+    int sector_size;
+    // FAT_DEV_MODE_MMAP maps the image, FAT_DEV_MODE_READ reads it through the block cache and the async backend.
+    int dev_mode;
+    // directory traversal threads, 0 uses one per cpu.
+    int threads;
+    // read directories level by level in ascending disk order.
+    bool io_order;
+    // reads kept in flight by the async backend, 0 uses the default.
+    uint32_t queue_depth;
+    // FAT_REP_TEXT or FAT_REP_JSON, and FAT_REP_SUMMARY .. FAT_REP_ENTRIES.
+    int report_format;
+    int report_level;
+    // repair through an undo journal at this path, NULL only checks.
+    const char* journal;
+    // sidecar of region hashes and parsed directories, NULL checks everything.
+    const char* sidecar;
+    // hash every file into a path and crc32c manifest at this path, NULL skips the content check.
+    const char* manifest;
+    // report the counters and phase times, and copy them out when stats_out is not NULL.
+    bool stats;
+    fat_ck_stats_t* stats_out;
+    // memory cap in bytes for the FAT table and cluster state, 0 keeps the whole table.
+    uint64_t max_mem;
+} fat_ck_opts_t;
+
+typedef struct fat_ck fat_ck_t;
+
+// one directory entry, valid during the callback only.
+typedef struct fat_ck_entry
+{
+    const char* name;
+    // start cluster of the directory holding the entry, 0 is the FAT12/16 root.
+    uint32_t parent;
+    uint32_t cluster;
+    uint32_t size;
+    uint8_t attr;
+    uint16_t wrt_time;
+    uint16_t wrt_date;
+} fat_ck_entry_t;
+
+// callbacks run on the calling thread of fatck_run, any of them may be NULL.
+typedef struct fat_ck_callbacks
+{
+    // every directory entry, in namespace order.
+    void (*entry)(void* user, const fat_ck_entry_t* entry);
+    // contiguous cluster runs of every claimed chain, start names the chain.
+    void (*chain)(void* user, uint32_t start, uint32_t first, uint32_t count);
+    // findings and errors, their text is formatted only for this callback.
+    void (*finding)(void* user, int level, const char* kind, const char* text);
+    void* user;
+} fat_ck_callbacks_t;
+
+typedef struct fat_ck_result
+{
+    // fatck_run result, 0 when the volume is clean.
+    int result;
+    uint32_t fat_type;
+    uint32_t errors;
+    uint32_t chains;
+    uint32_t cross_linked;
+    uint32_t lost_chains;
+    uint32_t lost_clusters;
+    uint32_t dirs_skipped;
+    fat_ck_stats_t stats;
+} fat_ck_result_t;
 
 int fatck(const char* path, int sector_size);
+int fatck_opts(const char* path, const fat_ck_opts_t* opts);
+// context api, report_level FAT_REP_NONE leaves all output to the callbacks.
+fat_ck_t* fatck_open(const char* path, const fat_ck_opts_t* opts);
+void fatck_callbacks(fat_ck_t* fc, const fat_ck_callbacks_t* callbacks);
+int fatck_run(fat_ck_t* fc);
+int fatck_result(fat_ck_t* fc, fat_ck_result_t* result);
+void fatck_close(fat_ck_t* fc);
+int fatck_layout(const char* path, const char* layout, const fat_ck_opts_t* opts);
+// file level diff of two images, 1 when they differ.
+int fatck_diff(const char* left, const char* right, const fat_ck_opts_t* opts);
+int fatck_undo(const char* path, const char* journal, int sector_size);
 
 #endif /* __FATCK_H__ */
\ No newline at end of file
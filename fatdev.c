@@ -1,10 +1,191 @@
 ﻿// fatdev.c : fat device operate source file
 #include "fatdev.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
-fat_dev_t* fat_dev_open(const char* path, int sector_size)
+#ifdef _WIN32
+typedef struct _stat64 fat_stat_t;
+#define fat_stat _stat64
+#else
+typedef struct stat fat_stat_t;
+#define fat_stat stat
+#endif
+
+// positional read, the shared file offset is never touched.
+static int fat_file_pread(int hand, uint64_t offset, uint8_t* buff, size_t size)
+{
+#ifdef _WIN32
+    OVERLAPPED overlap = { 0 };
+    DWORD done = 0;
+    overlap.Offset = (DWORD)offset;
+    overlap.OffsetHigh = (DWORD)(offset >> 32);
+    if (!ReadFile((HANDLE)_get_osfhandle(hand), buff, (DWORD)size, &done, &overlap))
+    {
+        return (GetLastError() == ERROR_HANDLE_EOF) ? 0 : -1;
+    }
+    return (int)done;
+#else
+    return (int)pread(hand, buff, size, (off_t)offset);
+#endif
+}
+
+static int fat_file_pwrite(int hand, uint64_t offset, const uint8_t* buff, size_t size)
+{
+#ifdef _WIN32
+    OVERLAPPED overlap = { 0 };
+    DWORD done = 0;
+    overlap.Offset = (DWORD)offset;
+    overlap.OffsetHigh = (DWORD)(offset >> 32);
+    if (!WriteFile((HANDLE)_get_osfhandle(hand), buff, (DWORD)size, &done, &overlap))
+    {
+        return -1;
+    }
+    return (int)done;
+#else
+    return (int)pwrite(hand, buff, size, (off_t)offset);
+#endif
+}
+
+static int fat_dev_mmap(fat_dev_t* device)
+{
+    // a 32-bit process can not map a huge image.
+    if ((device->file_size == 0) || (device->file_size > (uint64_t)SIZE_MAX))
+    {
+        return -1;
+    }
+#ifdef _WIN32
+    device->map_hand = CreateFileMapping((HANDLE)_get_osfhandle(device->file_hand), NULL, PAGE_READONLY, 0, 0, NULL);
+    if (device->map_hand == NULL)
+    {
+        return -1;
+    }
+    device->map_base = (uint8_t*)MapViewOfFile(device->map_hand, FILE_MAP_READ, 0, 0, 0);
+    if (device->map_base == NULL)
+    {
+        CloseHandle(device->map_hand);
+        device->map_hand = NULL;
+        return -1;
+    }
+#else
+    device->map_base = (uint8_t*)mmap(NULL, (size_t)device->file_size, PROT_READ, MAP_SHARED, device->file_hand, 0);
+    if (device->map_base == (uint8_t*)MAP_FAILED)
+    {
+        device->map_base = NULL;
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+static void fat_dev_munmap(fat_dev_t* device)
+{
+    if (device->map_base == NULL)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(device->map_base);
+    CloseHandle(device->map_hand);
+    device->map_hand = NULL;
+#else
+    munmap(device->map_base, (size_t)device->file_size);
+#endif
+    device->map_base = NULL;
+}
+
+// zeroed scratch memory backed by a deleted temporary file, the kernel pages it out instead of keeping it resident.
+uint8_t* fat_dev_spill(uint64_t size, void** hand)
+{
+    uint8_t* base = NULL;
+#ifdef _WIN32
+    char dir[MAX_PATH] = { 0 };
+    char path[MAX_PATH] = { 0 };
+    HANDLE file = INVALID_HANDLE_VALUE;
+
+    *hand = NULL;
+    if ((GetTempPathA(sizeof(dir), dir) == 0) || (GetTempFileNameA(dir, "fck", 0, path) == 0))
+    {
+        printf("fat spill file create failed.\r\n");
+        return NULL;
+    }
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        printf("fat spill file %s create failed.\r\n", path);
+        return NULL;
+    }
+    // the mapping keeps the file until it is closed, the file is deleted with it.
+    *hand = CreateFileMapping(file, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+    CloseHandle(file);
+    if (*hand == NULL)
+    {
+        printf("fat spill file %s map failed.\r\n", path);
+        return NULL;
+    }
+    base = (uint8_t*)MapViewOfFile(*hand, FILE_MAP_WRITE, 0, 0, (SIZE_T)size);
+    if (base == NULL)
+    {
+        printf("fat spill file %s map failed.\r\n", path);
+        CloseHandle(*hand);
+        *hand = NULL;
+    }
+#else
+    char path[0x200] = { 0 };
+    const char* dir = getenv("TMPDIR");
+    int file = -1;
+
+    *hand = NULL;
+    snprintf(path, sizeof(path), "%s/fatck.XXXXXX", ((dir != NULL) && (dir[0] != '\0')) ? dir : "/tmp");
+    file = mkstemp(path);
+    if (file < 0)
+    {
+        printf("fat spill file %s create failed.\r\n", path);
+        return NULL;
+    }
+    // unlinked at once, the mapping is the only reference left.
+    unlink(path);
+    if ((size > (uint64_t)SIZE_MAX) || (ftruncate(file, (off_t)size) != 0))
+    {
+        printf("fat spill file %s resize failed.\r\n", path);
+        close(file);
+        return NULL;
+    }
+    base = (uint8_t*)mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+    if (base == (uint8_t*)MAP_FAILED)
+    {
+        printf("fat spill file %s map failed.\r\n", path);
+        base = NULL;
+    }
+#endif
+    return base;
+}
+
+void fat_dev_unspill(uint8_t* base, uint64_t size, void* hand)
+{
+    if (base == NULL)
+    {
+        return;
+    }
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(base);
+    CloseHandle((HANDLE)hand);
+#else
+    (void)hand;
+    munmap(base, (size_t)size);
+#endif
+}
+
+fat_dev_t* fat_dev_open(const char* path, int sector_size, int mode)
 {
     fat_dev_t* device = NULL;
-    struct stat file_stat = { 0x00 };
+    fat_stat_t file_stat = { 0x00 };
 
     if ((path == NULL) || (sector_size == 0))
     {
@@ -12,7 +193,7 @@ fat_dev_t* fat_dev_open(const char* path, int sector_size)
         return NULL;
     }
     // file is exist.
-    if (stat(path, &file_stat) < 0)
+    if (fat_stat(path, &file_stat) < 0)
     {
         printf("file %s is not exist.\r\n", path);
         return NULL;
@@ -30,9 +211,9 @@ fat_dev_t* fat_dev_open(const char* path, int sector_size)
         return NULL;
     }
     // get file size.
-    device->file_size = file_stat.st_size;
+    device->file_size = (uint64_t)file_stat.st_size;
     // open file.
-    device->file_hand = open(path, O_RDONLY | O_BINARY);
+    device->file_hand = open(path, ((mode & FAT_DEV_MODE_WRITE) ? O_RDWR : O_RDONLY) | O_BINARY);
     if (device->file_hand < 0)
     {
         printf("file %s open failed.\r\n", path);
@@ -40,24 +221,335 @@ fat_dev_t* fat_dev_open(const char* path, int sector_size)
         return NULL;
     }
     device->sector_size = sector_size;
+    fat_mutex_init(&device->lock);
+    // map the whole image, the checker reads it in place.
+    if ((mode & ~FAT_DEV_MODE_WRITE) == FAT_DEV_MODE_MMAP)
+    {
+        if (fat_dev_mmap(device) == 0)
+        {
+            device->mode = FAT_DEV_MODE_MMAP;
+            return device;
+        }
+        printf("file %s mmap failed, fall back to read.\r\n", path);
+    }
+    device->mode = FAT_DEV_MODE_READ;
+    // enable block cache with default geometry.
+    if (fat_dev_cache(device, FAT_DEV_CACHE_PAGE_SIZE, FAT_DEV_CACHE_PAGE_COUNT) < 0)
+    {
+        printf("fat device cache init failed, read without cache.\r\n");
+    }
     return device;
 }
 
-int fat_dev_read(fat_dev_t* device, size_t offset, uint8_t *buff, size_t size)
+fat_dev_t* fat_dev_view(fat_dev_t* device, uint64_t offset, uint64_t size)
+{
+    fat_dev_t* view = NULL;
+    if ((device == NULL) || (offset >= device->file_size))
+    {
+        printf("fat device view at 0x%08llX is out of device.\r\n", (unsigned long long)offset);
+        return NULL;
+    }
+    view = (fat_dev_t*)calloc(1, sizeof(fat_dev_t));
+    if (view == NULL)
+    {
+        printf("fat device view build failed.\r\n");
+        return NULL;
+    }
+    // the window is clipped to the parent device.
+    view->parent = device;
+    view->base = offset;
+    view->file_hand = device->file_hand;
+    view->file_size = (size < (device->file_size - offset)) ? size : (device->file_size - offset);
+    view->sector_size = device->sector_size;
+    view->mode = device->mode;
+    return view;
+}
+
+static int fat_dev_load(fat_dev_t* device, uint64_t offset, uint8_t* buff, size_t size)
 {
     int result = 0;
+    size_t done = 0;
+    // short reads are retried, 0 is the end of file.
+    while (done < size)
+    {
+        result = fat_file_pread(device->file_hand, offset + done, buff + done, size - done);
+        if (result < 0)
+        {
+            printf("fat device read offset 0x%08llX failed.\r\n", (unsigned long long)(offset + done));
+            return -1;
+        }
+        if (result == 0)
+        {
+            break;
+        }
+        done = done + result;
+    }
+    return (int)done;
+}
+
+static void fat_dev_page_unlink(fat_dev_cache_t* cache, int slot)
+{
+    fat_dev_page_t* page = &cache->pages[slot];
+    if (page->prev >= 0)
+    {
+        cache->pages[page->prev].next = page->next;
+    }
+    else
+    {
+        cache->head = page->next;
+    }
+    if (page->next >= 0)
+    {
+        cache->pages[page->next].prev = page->prev;
+    }
+    else
+    {
+        cache->tail = page->prev;
+    }
+    page->prev = -1;
+    page->next = -1;
+}
+
+static void fat_dev_page_push(fat_dev_cache_t* cache, int slot, bool head)
+{
+    fat_dev_page_t* page = &cache->pages[slot];
+    if (head)
+    {
+        page->prev = -1;
+        page->next = cache->head;
+        if (cache->head >= 0)
+        {
+            cache->pages[cache->head].prev = slot;
+        }
+        cache->head = slot;
+        cache->tail = (cache->tail < 0) ? slot : cache->tail;
+    }
+    else
+    {
+        page->next = -1;
+        page->prev = cache->tail;
+        if (cache->tail >= 0)
+        {
+            cache->pages[cache->tail].next = slot;
+        }
+        cache->tail = slot;
+        cache->head = (cache->head < 0) ? slot : cache->head;
+    }
+}
+
+static void fat_dev_page_drop(fat_dev_cache_t* cache, int slot)
+{
+    fat_dev_page_t* page = &cache->pages[slot];
+    int* link = NULL;
+    if (page->index == FAT_DEV_CACHE_PAGE_NONE)
+    {
+        return;
+    }
+    // remove page from hash bucket chain.
+    link = &cache->buckets[page->index % cache->bucket_count];
+    while (*link >= 0)
+    {
+        if (*link == slot)
+        {
+            *link = page->hash;
+            break;
+        }
+        link = &cache->pages[*link].hash;
+    }
+    page->index = FAT_DEV_CACHE_PAGE_NONE;
+    page->valid = 0;
+    page->hash = -1;
+    // invalid page is the first one to reuse.
+    fat_dev_page_unlink(cache, slot);
+    fat_dev_page_push(cache, slot, false);
+}
+
+static fat_dev_page_t* fat_dev_page_get(fat_dev_t* device, size_t index)
+{
+    int result = 0;
+    int slot = 0;
+    fat_dev_cache_t* cache = &device->cache;
+    fat_dev_page_t* page = NULL;
+    int* bucket = &cache->buckets[index % cache->bucket_count];
+
+    // page hit, move it to lru head.
+    for (slot = *bucket; slot >= 0; slot = cache->pages[slot].hash)
+    {
+        if (cache->pages[slot].index == index)
+        {
+            cache->hits = cache->hits + 1;
+            fat_dev_page_unlink(cache, slot);
+            fat_dev_page_push(cache, slot, true);
+            return &cache->pages[slot];
+        }
+    }
+    // page miss, evict the least recently used page.
+    cache->misses = cache->misses + 1;
+    cache->reads = cache->reads + 1;
+    slot = cache->tail;
+    fat_dev_page_drop(cache, slot);
+    page = &cache->pages[slot];
+    result = fat_dev_load(device, (uint64_t)index * cache->page_size, page->data, cache->page_size);
+    if (result <= 0)
+    {
+        return NULL;
+    }
+    page->index = index;
+    page->valid = result;
+    page->hash = *bucket;
+    *bucket = slot;
+    fat_dev_page_unlink(cache, slot);
+    fat_dev_page_push(cache, slot, true);
+    return page;
+}
+
+static void fat_dev_cache_free(fat_dev_cache_t* cache)
+{
+    uint32_t index = 0;
+    if (cache->pages != NULL)
+    {
+        for (index = 0; index < cache->page_count; index++)
+        {
+            free(cache->pages[index].data);
+        }
+        free(cache->pages);
+    }
+    if (cache->buckets != NULL)
+    {
+        free(cache->buckets);
+    }
+    cache->pages = NULL;
+    cache->buckets = NULL;
+    cache->page_count = 0;
+    cache->bucket_count = 0;
+    cache->head = -1;
+    cache->tail = -1;
+}
+
+int fat_dev_cache(fat_dev_t* device, uint32_t page_size, uint32_t page_count)
+{
+    uint32_t index = 0;
+    fat_dev_cache_t* cache = NULL;
+    if ((device == NULL) || (device->sector_size == 0))
+    {
+        printf("fat device cache failed, parameter is null.\r\n");
+        return -1;
+    }
+    cache = &device->cache;
+    fat_dev_cache_free(cache);
+    // page count 0 disable the cache.
+    if ((page_size == 0) || (page_count == 0))
+    {
+        return 0;
+    }
+    // keep pages sector aligned.
+    page_size = ((page_size + device->sector_size - 1) / device->sector_size) * device->sector_size;
+    cache->pages = (fat_dev_page_t*)calloc(page_count, sizeof(fat_dev_page_t));
+    cache->buckets = (int*)malloc(page_count * 2 * sizeof(int));
+    if ((cache->pages == NULL) || (cache->buckets == NULL))
+    {
+        fat_dev_cache_free(cache);
+        return -1;
+    }
+    cache->page_size = page_size;
+    cache->page_count = page_count;
+    cache->bucket_count = page_count * 2;
+    for (index = 0; index < cache->bucket_count; index++)
+    {
+        cache->buckets[index] = -1;
+    }
+    for (index = 0; index < page_count; index++)
+    {
+        cache->pages[index].data = (uint8_t*)malloc(page_size);
+        if (cache->pages[index].data == NULL)
+        {
+            fat_dev_cache_free(cache);
+            return -1;
+        }
+        cache->pages[index].index = FAT_DEV_CACHE_PAGE_NONE;
+        cache->pages[index].hash = -1;
+        fat_dev_page_push(cache, index, false);
+    }
+    return 0;
+}
+
+const uint8_t* fat_dev_map(fat_dev_t* device, uint64_t offset, size_t size)
+{
+    if (device == NULL)
+    {
+        return NULL;
+    }
+    if ((offset > device->file_size) || (size > (device->file_size - offset)))
+    {
+        return NULL;
+    }
+    if (device->parent != NULL)
+    {
+        return fat_dev_map(device->parent, device->base + offset, size);
+    }
+    if (device->map_base == NULL)
+    {
+        return NULL;
+    }
+    return device->map_base + offset;
+}
+
+int fat_dev_read(fat_dev_t* device, uint64_t offset, uint8_t *buff, size_t size)
+{
+    int result = 0;
+    size_t done = 0;
+    size_t skip = 0;
+    size_t copy = 0;
+    fat_dev_page_t* page = NULL;
     if ((device == NULL) || (device->file_hand < 0) || (buff == NULL) || (size <= 0))
     {
         printf("fat device read failed, parameter is null.\r\n");
         return -1;
     }
-    result = lseek(device->file_hand, offset, SEEK_SET);
-    if (result < 0)
+    if (device->parent != NULL)
     {
-        printf("fat device read lseek offset %d failed.\r\n", offset);
-        return -1;
+        if ((offset > device->file_size) || (size > (device->file_size - offset)))
+        {
+            printf("fat device read failed.\r\n");
+            return -1;
+        }
+        return fat_dev_read(device->parent, device->base + offset, buff, size);
+    }
+    // copy out of the mapped image.
+    if (device->map_base != NULL)
+    {
+        if (fat_dev_map(device, offset, size) == NULL)
+        {
+            printf("fat device read failed.\r\n");
+            return -1;
+        }
+        memcpy(buff, device->map_base + offset, size);
+        return (int)size;
+    }
+    // read through the block cache page by page.
+    if (device->cache.page_count > 0)
+    {
+        fat_mutex_lock(&device->lock);
+        while (done < size)
+        {
+            page = fat_dev_page_get(device, (size_t)((offset + done) / device->cache.page_size));
+            skip = (size_t)((offset + done) % device->cache.page_size);
+            if ((page == NULL) || (page->valid <= skip))
+            {
+                fat_mutex_unlock(&device->lock);
+                printf("fat device read failed.\r\n");
+                return -1;
+            }
+            copy = page->valid - skip;
+            copy = (copy < (size - done)) ? copy : (size - done);
+            memcpy(buff + done, page->data + skip, copy);
+            done = done + copy;
+        }
+        fat_mutex_unlock(&device->lock);
+        return (int)done;
     }
-    result = read(device->file_hand, buff, size);
+    // uncached reads are positional and need no lock.
+    result = fat_dev_load(device, offset, buff, size);
     if (result != size)
     {
         printf("fat device read failed.\r\n");
@@ -66,29 +558,117 @@ int fat_dev_read(fat_dev_t* device, size_t offset, uint8_t *buff, size_t size)
     return result;
 }
 
-int fat_dev_write(fat_dev_t* device, size_t offset, uint8_t *buff, size_t size)
+int fat_dev_advise(fat_dev_t* device, uint64_t offset, uint64_t size)
+{
+    uint64_t align = 0;
+    if ((device == NULL) || (offset >= device->file_size))
+    {
+        return -1;
+    }
+    size = (size < (device->file_size - offset)) ? size : (device->file_size - offset);
+    if (device->parent != NULL)
+    {
+        return fat_dev_advise(device->parent, device->base + offset, size);
+    }
+#ifdef _WIN32
+    // no portable hint, windows relies on its own readahead.
+    return 0;
+#else
+    // ask the kernel to start reading, the data is consumed later.
+    if (device->map_base != NULL)
+    {
+        align = offset % (uint64_t)sysconf(_SC_PAGESIZE);
+        return madvise(device->map_base + offset - align, (size_t)(size + align), MADV_WILLNEED);
+    }
+    return posix_fadvise(device->file_hand, (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED);
+#endif
+}
+
+int fat_dev_pread(fat_dev_t* device, uint64_t offset, uint8_t* buff, size_t size)
+{
+    if ((device == NULL) || (buff == NULL) || (offset > device->file_size) || (size > (device->file_size - offset)))
+    {
+        printf("fat device pread failed.\r\n");
+        return -1;
+    }
+    // bypass the block cache, safe to call from any thread.
+    if (device->parent != NULL)
+    {
+        return fat_dev_pread(device->parent, device->base + offset, buff, size);
+    }
+    return fat_dev_load(device, offset, buff, size);
+}
+
+int fat_dev_write(fat_dev_t* device, uint64_t offset, uint8_t *buff, size_t size)
 {
     int result = 0;
+    int slot = 0;
+    size_t index = 0;
+    size_t done = 0;
     if ((device == NULL) || (device->file_hand < 0) || (buff == NULL) || (size <= 0))
     {
         printf("fat device write failed, parameter is null.\r\n");
         return -1;
     }
-    result = lseek(device->file_hand, offset, SEEK_SET);
-    if (result < 0)
+    if (device->parent != NULL)
     {
-        printf("fat device write lseek to %d failed.\r\n", offset);
-        return -1;
+        if ((offset > device->file_size) || (size > (device->file_size - offset)))
+        {
+            printf("fat device write failed.\r\n");
+            return -1;
+        }
+        return fat_dev_write(device->parent, device->base + offset, buff, size);
     }
-    result = write(device->file_hand, buff, size);
-    if (result != size)
+    while (done < size)
     {
-        printf("fat device write failed.\r\n");
-        return -1;
+        result = fat_file_pwrite(device->file_hand, offset + done, buff + done, size - done);
+        if (result <= 0)
+        {
+            printf("fat device write offset 0x%08llX failed.\r\n", (unsigned long long)(offset + done));
+            return -1;
+        }
+        done = done + result;
+    }
+    result = (int)done;
+    // drop cached pages covered by this write.
+    fat_mutex_lock(&device->lock);
+    if (device->cache.page_count > 0)
+    {
+        for (index = (size_t)(offset / device->cache.page_size); index <= (size_t)((offset + size - 1) / device->cache.page_size); index++)
+        {
+            for (slot = device->cache.buckets[index % device->cache.bucket_count]; slot >= 0; slot = device->cache.pages[slot].hash)
+            {
+                if (device->cache.pages[slot].index == index)
+                {
+                    fat_dev_page_drop(&device->cache, slot);
+                    break;
+                }
+            }
+        }
     }
+    fat_mutex_unlock(&device->lock);
     return result;
 }
 
+int fat_dev_sync(fat_dev_t* device)
+{
+    if ((device == NULL) || (device->file_hand < 0))
+    {
+        printf("fat device sync failed, parameter is null.\r\n");
+        return -1;
+    }
+    if (device->parent != NULL)
+    {
+        return fat_dev_sync(device->parent);
+    }
+    // written sectors reach the disk before the caller moves on.
+#ifdef _WIN32
+    return _commit(device->file_hand);
+#else
+    return fsync(device->file_hand);
+#endif
+}
+
 int fat_dev_close(fat_dev_t* device)
 {
     int result = 0;
@@ -97,6 +677,14 @@ int fat_dev_close(fat_dev_t* device)
         printf("fat device close failed, parameter is null.\r\n");
         return -1;
     }
+    // the parent owns the file of a window.
+    if (device->parent != NULL)
+    {
+        return 0;
+    }
+    fat_dev_cache_free(&device->cache);
+    fat_dev_munmap(device);
+    fat_mutex_free(&device->lock);
     result = close(device->file_hand);
     return result;
 }
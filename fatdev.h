@@ -2,6 +2,11 @@
 #ifndef __FATDEV_H__
 #define __FATDEV_H__
 
+// 64-bit file offsets for images larger than 4 GB.
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
@@ -12,20 +17,72 @@
 #include <sys/stat.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include "fatpool.h"
+
+// default block cache geometry (page size is rounded up to the sector size)
+#define FAT_DEV_CACHE_PAGE_SIZE     (0x8000)
+#define FAT_DEV_CACHE_PAGE_COUNT    (0x80)
+#define FAT_DEV_CACHE_PAGE_NONE     ((size_t)-1)
+
+// device backend, mmap falls back to read when the image can not be mapped
+#define FAT_DEV_MODE_READ           (0)
+#define FAT_DEV_MODE_MMAP           (1)
+// open flag, or'ed into the mode when the device is going to be repaired
+#define FAT_DEV_MODE_WRITE          (0x10)
+
+typedef struct fat_dev_page
+{
+    uint8_t* data;
+    size_t index;
+    size_t valid;
+    int prev;
+    int next;
+    int hash;
+} fat_dev_page_t;
+
+typedef struct fat_dev_cache
+{
+    fat_dev_page_t* pages;
+    int* buckets;
+    uint32_t page_size;
+    uint32_t page_count;
+    uint32_t bucket_count;
+    int head;
+    int tail;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t reads;
+} fat_dev_cache_t;
 
 typedef struct fat_dev
 {
+    // window devices read through their parent at base offset.
+    struct fat_dev* parent;
+    uint64_t base;
     int file_hand;
-    uint32_t file_size;
-    uint32_t sector_count;
+    uint64_t file_size;
+    uint64_t sector_count;
     uint32_t sector_size;
     uint32_t part_start;
     uint32_t block_size;
+    int mode;
+    uint8_t* map_base;
+    void* map_hand;
+    fat_mutex_t lock;
+    fat_dev_cache_t cache;
 } fat_dev_t;
 
-fat_dev_t* fat_dev_open(const char* path, int sector_size);
-int fat_dev_read(fat_dev_t* device, size_t offset, uint8_t* buff, size_t size);
-int fat_dev_write(fat_dev_t* device, size_t offset, uint8_t* buff, size_t size);
+fat_dev_t* fat_dev_open(const char* path, int sector_size, int mode);
+fat_dev_t* fat_dev_view(fat_dev_t* device, uint64_t offset, uint64_t size);
+const uint8_t* fat_dev_map(fat_dev_t* device, uint64_t offset, size_t size);
+int fat_dev_cache(fat_dev_t* device, uint32_t page_size, uint32_t page_count);
+int fat_dev_read(fat_dev_t* device, uint64_t offset, uint8_t* buff, size_t size);
+int fat_dev_advise(fat_dev_t* device, uint64_t offset, uint64_t size);
+int fat_dev_pread(fat_dev_t* device, uint64_t offset, uint8_t* buff, size_t size);
+int fat_dev_write(fat_dev_t* device, uint64_t offset, uint8_t* buff, size_t size);
+int fat_dev_sync(fat_dev_t* device);
 int fat_dev_close(fat_dev_t* device);
+uint8_t* fat_dev_spill(uint64_t size, void** hand);
+void fat_dev_unspill(uint8_t* base, uint64_t size, void* hand);
 
 #endif /* __FATDEV_H__ */
\ No newline at end of file
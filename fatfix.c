@@ -0,0 +1,342 @@
+// fatfix.c : fat repair write set and undo journal source file
+#include "fatfix.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+static void fat_fix_put64(uint8_t* buff, uint64_t value)
+{
+    int index = 0;
+    for (index = 0; index < 8; index++)
+    {
+        buff[index] = (uint8_t)(value >> (index * 8));
+    }
+}
+
+static uint64_t fat_fix_get64(const uint8_t* buff)
+{
+    int index = 0;
+    uint64_t value = 0;
+    for (index = 7; index >= 0; index--)
+    {
+        value = (value << 8) | buff[index];
+    }
+    return value;
+}
+
+static int fat_fix_compare(const void* a, const void* b)
+{
+    const fat_fix_sector_t* x = (const fat_fix_sector_t*)a;
+    const fat_fix_sector_t* y = (const fat_fix_sector_t*)b;
+    return (x->sector < y->sector) ? -1 : ((x->sector > y->sector) ? 1 : 0);
+}
+
+static void fat_fix_reset(fat_fix_t* fix)
+{
+    uint32_t index = 0;
+    for (index = 0; index < fix->count; index++)
+    {
+        free(fix->sectors[index].data);
+        free(fix->sectors[index].orig);
+    }
+    fix->count = 0;
+    fix->patches = 0;
+    for (index = 0; index < FAT_FIX_BUCKETS; index++)
+    {
+        fix->buckets[index] = -1;
+    }
+}
+
+static fat_fix_sector_t* fat_fix_get(fat_fix_t* fix, uint64_t sector, bool load)
+{
+    int slot = 0;
+    uint32_t limit = 0;
+    int* bucket = &fix->buckets[sector % FAT_FIX_BUCKETS];
+    fat_fix_sector_t* sectors = NULL;
+    fat_fix_sector_t* item = NULL;
+
+    for (slot = *bucket; slot >= 0; slot = fix->sectors[slot].hash)
+    {
+        if (fix->sectors[slot].sector == sector)
+        {
+            return &fix->sectors[slot];
+        }
+    }
+    if (!load)
+    {
+        return NULL;
+    }
+    if (fix->count >= fix->limit)
+    {
+        limit = (fix->limit == 0) ? 0x40 : (fix->limit * 2);
+        sectors = (fat_fix_sector_t*)realloc(fix->sectors, limit * sizeof(fat_fix_sector_t));
+        if (sectors == NULL)
+        {
+            fat_rep_note(fix->rep, FAT_REP_SUMMARY, "error", "fat fix sector table malloc failed.");
+            return NULL;
+        }
+        fix->sectors = sectors;
+        fix->limit = limit;
+    }
+    // keep the original sector for the undo journal.
+    item = &fix->sectors[fix->count];
+    item->sector = sector;
+    item->data = (uint8_t*)malloc(fix->sector_size);
+    item->orig = (uint8_t*)malloc(fix->sector_size);
+    if ((item->data == NULL) || (item->orig == NULL) ||
+        (fat_dev_read(fix->device, sector * fix->sector_size, item->orig, fix->sector_size) != (int)fix->sector_size))
+    {
+        fat_rep_note(fix->rep, FAT_REP_SUMMARY, "error", "fat fix sector %llu load failed.", (unsigned long long)sector);
+        free(item->data);
+        free(item->orig);
+        return NULL;
+    }
+    memcpy(item->data, item->orig, fix->sector_size);
+    item->hash = *bucket;
+    *bucket = (int)fix->count;
+    fix->count = fix->count + 1;
+    return item;
+}
+
+fat_fix_t* fat_fix_create(fat_dev_t* device, fat_rep_t* rep)
+{
+    fat_fix_t* fix = NULL;
+    if ((device == NULL) || (rep == NULL) || (device->sector_size == 0))
+    {
+        printf("fat fix create failed, parameter is null.\r\n");
+        return NULL;
+    }
+    fix = (fat_fix_t*)calloc(1, sizeof(fat_fix_t));
+    if (fix == NULL)
+    {
+        printf("fat fix create failed.\r\n");
+        return NULL;
+    }
+    fix->device = device;
+    fix->rep = rep;
+    fix->sector_size = device->sector_size;
+    fat_fix_reset(fix);
+    return fix;
+}
+
+int fat_fix_peek(fat_fix_t* fix, uint64_t offset, uint8_t* buff, size_t size)
+{
+    size_t done = 0;
+    size_t skip = 0;
+    size_t copy = 0;
+    fat_fix_sector_t* item = NULL;
+
+    // read through the planned changes, sector by sector.
+    while (done < size)
+    {
+        skip = (size_t)((offset + done) % fix->sector_size);
+        copy = fix->sector_size - skip;
+        copy = (copy < (size - done)) ? copy : (size - done);
+        item = fat_fix_get(fix, (offset + done) / fix->sector_size, false);
+        if (item != NULL)
+        {
+            memcpy(buff + done, item->data + skip, copy);
+        }
+        else if (fat_dev_read(fix->device, offset + done, buff + done, copy) != (int)copy)
+        {
+            return -1;
+        }
+        done = done + copy;
+    }
+    return (int)done;
+}
+
+int fat_fix_patch(fat_fix_t* fix, uint64_t offset, const uint8_t* data, size_t size)
+{
+    size_t done = 0;
+    size_t skip = 0;
+    size_t copy = 0;
+    fat_fix_sector_t* item = NULL;
+
+    // patches land in whole sector buffers, later patches see earlier ones.
+    while (done < size)
+    {
+        skip = (size_t)((offset + done) % fix->sector_size);
+        copy = fix->sector_size - skip;
+        copy = (copy < (size - done)) ? copy : (size - done);
+        item = fat_fix_get(fix, (offset + done) / fix->sector_size, true);
+        if (item == NULL)
+        {
+            return -1;
+        }
+        memcpy(item->data + skip, data + done, copy);
+        done = done + copy;
+    }
+    fix->patches = fix->patches + 1;
+    return 0;
+}
+
+static int fat_fix_journal(fat_fix_t* fix, const char* journal, uint32_t dirty)
+{
+    FILE* file = NULL;
+    uint8_t head[16] = { 0x00 };
+    uint32_t index = 0;
+    bool failed = false;
+
+    file = fopen(journal, "wb");
+    if (file == NULL)
+    {
+        fat_rep_note(fix->rep, FAT_REP_SUMMARY, "error", "fat fix journal %s open failed.", journal);
+        return -1;
+    }
+    memcpy(head, FAT_FIX_MAGIC, 8);
+    fat_fix_put64(&head[8], ((uint64_t)dirty << 32) | fix->sector_size);
+    failed = (fwrite(head, 1, sizeof(head), file) != sizeof(head));
+    for (index = 0; (index < fix->count) && !failed; index++)
+    {
+        if (memcmp(fix->sectors[index].data, fix->sectors[index].orig, fix->sector_size) == 0)
+        {
+            continue;
+        }
+        fat_fix_put64(head, fix->sectors[index].sector * fix->sector_size);
+        failed = (fwrite(head, 1, 8, file) != 8) ||
+            (fwrite(fix->sectors[index].orig, 1, fix->sector_size, file) != fix->sector_size);
+    }
+    // the tail marker makes the journal valid, only then the device is touched.
+    failed = failed || (fwrite(FAT_FIX_TAIL, 1, 8, file) != 8) || (fflush(file) != 0);
+#ifdef _WIN32
+    failed = failed || (_commit(_fileno(file)) != 0);
+#else
+    failed = failed || (fsync(fileno(file)) != 0);
+#endif
+    fclose(file);
+    if (failed)
+    {
+        fat_rep_note(fix->rep, FAT_REP_SUMMARY, "error", "fat fix journal %s write failed.", journal);
+        return -1;
+    }
+    return 0;
+}
+
+int fat_fix_commit(fat_fix_t* fix, const char* journal)
+{
+    uint8_t* buff = NULL;
+    uint32_t index = 0;
+    uint32_t last = 0;
+    uint32_t dirty = 0;
+    uint32_t run = 0;
+    int result = 0;
+
+    fix->writes = 0;
+    fix->written = 0;
+    // drop sectors that ended up unchanged, then write in disk order.
+    for (index = 0; index < fix->count; index++)
+    {
+        if (memcmp(fix->sectors[index].data, fix->sectors[index].orig, fix->sector_size) != 0)
+        {
+            fix->sectors[dirty] = fix->sectors[index];
+            dirty = dirty + 1;
+        }
+        else
+        {
+            free(fix->sectors[index].data);
+            free(fix->sectors[index].orig);
+        }
+    }
+    fix->count = dirty;
+    if (dirty == 0)
+    {
+        fat_fix_reset(fix);
+        return 0;
+    }
+    qsort(fix->sectors, fix->count, sizeof(fat_fix_sector_t), fat_fix_compare);
+    if ((journal == NULL) || (fat_fix_journal(fix, journal, dirty) < 0))
+    {
+        fat_fix_reset(fix);
+        return -1;
+    }
+    buff = (uint8_t*)malloc((size_t)fix->count * fix->sector_size);
+    if (buff == NULL)
+    {
+        fat_rep_note(fix->rep, FAT_REP_SUMMARY, "error", "fat fix write buffer malloc failed.");
+        fat_fix_reset(fix);
+        return -1;
+    }
+    // adjacent sectors go out as one write.
+    for (index = 0; (index < fix->count) && (result == 0); index = last)
+    {
+        for (last = index, run = 0; (last < fix->count) && (fix->sectors[last].sector == fix->sectors[index].sector + run); last++, run++)
+        {
+            memcpy(buff + (size_t)run * fix->sector_size, fix->sectors[last].data, fix->sector_size);
+        }
+        if (fat_dev_write(fix->device, fix->sectors[index].sector * fix->sector_size, buff, (size_t)run * fix->sector_size) != (int)(run * fix->sector_size))
+        {
+            result = -1;
+            break;
+        }
+        fix->writes = fix->writes + 1;
+        fix->written = fix->written + run;
+    }
+    free(buff);
+    result = (result == 0) ? fat_dev_sync(fix->device) : result;
+    fat_fix_reset(fix);
+    return result;
+}
+
+int fat_fix_undo(fat_dev_t* device, const char* journal)
+{
+    FILE* file = NULL;
+    uint8_t head[16] = { 0x00 };
+    uint8_t* data = NULL;
+    uint64_t value = 0;
+    uint32_t sector_size = 0;
+    uint32_t count = 0;
+    uint32_t index = 0;
+    size_t record = 0;
+    int result = 0;
+
+    file = fopen(journal, "rb");
+    if (file == NULL)
+    {
+        printf("fat fix journal %s open failed.\r\n", journal);
+        return -1;
+    }
+    if ((fread(head, 1, sizeof(head), file) != sizeof(head)) || (memcmp(head, FAT_FIX_MAGIC, 8) != 0))
+    {
+        printf("fat fix journal %s is not an undo journal.\r\n", journal);
+        fclose(file);
+        return -1;
+    }
+    value = fat_fix_get64(&head[8]);
+    sector_size = (uint32_t)value;
+    count = (uint32_t)(value >> 32);
+    record = 8 + (size_t)sector_size;
+    // load everything first, a journal without its tail is never applied.
+    data = (uint8_t*)malloc(record * count + 8);
+    if ((data == NULL) || (fread(data, 1, record * count + 8, file) != record * count + 8) ||
+        (memcmp(data + record * count, FAT_FIX_TAIL, 8) != 0))
+    {
+        printf("fat fix journal %s is incomplete, the device was not modified.\r\n", journal);
+        free(data);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    for (index = 0; (index < count) && (result == 0); index++)
+    {
+        value = fat_fix_get64(data + record * index);
+        if (fat_dev_write(device, value, data + record * index + 8, sector_size) != (int)sector_size)
+        {
+            result = -1;
+        }
+    }
+    free(data);
+    result = (result == 0) ? fat_dev_sync(device) : result;
+    return (result == 0) ? (int)count : result;
+}
+
+void fat_fix_free(fat_fix_t* fix)
+{
+    if (fix == NULL)
+    {
+        return;
+    }
+    fat_fix_reset(fix);
+    free(fix->sectors);
+    free(fix);
+}
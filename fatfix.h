@@ -0,0 +1,46 @@
+// fatfix.h : fat repair write set and undo journal header file
+#ifndef __FATFIX_H__
+#define __FATFIX_H__
+
+#include "fatdev.h"
+#include "fatrep.h"
+
+// hash buckets of the dirty sector table
+#define FAT_FIX_BUCKETS     (0x400)
+
+// undo journal markers, the tail marker is written last
+#define FAT_FIX_MAGIC       "FATUNDO1"
+#define FAT_FIX_TAIL        "FATUNDOK"
+
+typedef struct fat_fix_sector
+{
+    uint64_t sector;
+    uint8_t* data;
+    uint8_t* orig;
+    int hash;
+} fat_fix_sector_t;
+
+typedef struct fat_fix
+{
+    fat_dev_t* device;
+    // load and commit failures are noted in the caller's report.
+    fat_rep_t* rep;
+    uint32_t sector_size;
+    fat_fix_sector_t* sectors;
+    uint32_t count;
+    uint32_t limit;
+    int buckets[FAT_FIX_BUCKETS];
+    // planned patches, and the result of the last commit.
+    uint32_t patches;
+    uint32_t writes;
+    uint32_t written;
+} fat_fix_t;
+
+fat_fix_t* fat_fix_create(fat_dev_t* device, fat_rep_t* rep);
+int fat_fix_peek(fat_fix_t* fix, uint64_t offset, uint8_t* buff, size_t size);
+int fat_fix_patch(fat_fix_t* fix, uint64_t offset, const uint8_t* data, size_t size);
+int fat_fix_commit(fat_fix_t* fix, const char* journal);
+int fat_fix_undo(fat_dev_t* device, const char* journal);
+void fat_fix_free(fat_fix_t* fix);
+
+#endif /* __FATFIX_H__ */
@@ -0,0 +1,286 @@
+// fathash.c : fat check region hash and sidecar map source file
+#include "fathash.h"
+
+#define FAT_HASH_PRIME1     (0x9E3779B185EBCA87ULL)
+#define FAT_HASH_PRIME2     (0xC2B2AE3D27D4EB4FULL)
+#define FAT_HASH_PRIME3     (0x165667B19E3779F9ULL)
+#define FAT_HASH_PRIME4     (0x85EBCA77C2B2AE63ULL)
+#define FAT_HASH_PRIME5     (0x27D4EB2F165667C5ULL)
+#define FAT_HASH_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t fat_hash_read64(const uint8_t* data)
+{
+    uint64_t value = 0;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint64_t fat_hash_round(uint64_t acc, uint64_t input)
+{
+    acc = acc + input * FAT_HASH_PRIME2;
+    acc = FAT_HASH_ROTL(acc, 31);
+    return acc * FAT_HASH_PRIME1;
+}
+
+static uint64_t fat_hash_merge(uint64_t acc, uint64_t value)
+{
+    acc = acc ^ fat_hash_round(0, value);
+    return acc * FAT_HASH_PRIME1 + FAT_HASH_PRIME4;
+}
+
+// xxHash64, four independent lanes over 32 byte stripes.
+uint64_t fat_hash64(const void* data, size_t size, uint64_t seed)
+{
+    const uint8_t* input = (const uint8_t*)data;
+    const uint8_t* end = input + size;
+    uint64_t lane[4] = { 0 };
+    uint64_t hash = 0;
+    uint32_t word = 0;
+
+    if (size >= 32)
+    {
+        lane[0] = seed + FAT_HASH_PRIME1 + FAT_HASH_PRIME2;
+        lane[1] = seed + FAT_HASH_PRIME2;
+        lane[2] = seed;
+        lane[3] = seed - FAT_HASH_PRIME1;
+        for (; input + 32 <= end; input = input + 32)
+        {
+            lane[0] = fat_hash_round(lane[0], fat_hash_read64(input));
+            lane[1] = fat_hash_round(lane[1], fat_hash_read64(input + 8));
+            lane[2] = fat_hash_round(lane[2], fat_hash_read64(input + 16));
+            lane[3] = fat_hash_round(lane[3], fat_hash_read64(input + 24));
+        }
+        hash = FAT_HASH_ROTL(lane[0], 1) + FAT_HASH_ROTL(lane[1], 7) + FAT_HASH_ROTL(lane[2], 12) + FAT_HASH_ROTL(lane[3], 18);
+        hash = fat_hash_merge(hash, lane[0]);
+        hash = fat_hash_merge(hash, lane[1]);
+        hash = fat_hash_merge(hash, lane[2]);
+        hash = fat_hash_merge(hash, lane[3]);
+    }
+    else
+    {
+        hash = seed + FAT_HASH_PRIME5;
+    }
+    hash = hash + (uint64_t)size;
+    for (; input + 8 <= end; input = input + 8)
+    {
+        hash = hash ^ fat_hash_round(0, fat_hash_read64(input));
+        hash = FAT_HASH_ROTL(hash, 27) * FAT_HASH_PRIME1 + FAT_HASH_PRIME4;
+    }
+    if (input + 4 <= end)
+    {
+        memcpy(&word, input, sizeof(word));
+        hash = hash ^ ((uint64_t)word * FAT_HASH_PRIME1);
+        hash = FAT_HASH_ROTL(hash, 23) * FAT_HASH_PRIME2 + FAT_HASH_PRIME3;
+        input = input + 4;
+    }
+    for (; input < end; input++)
+    {
+        hash = hash ^ (*input * FAT_HASH_PRIME5);
+        hash = FAT_HASH_ROTL(hash, 11) * FAT_HASH_PRIME1;
+    }
+    hash = hash ^ (hash >> 33);
+    hash = hash * FAT_HASH_PRIME2;
+    hash = hash ^ (hash >> 29);
+    hash = hash * FAT_HASH_PRIME3;
+    return hash ^ (hash >> 32);
+}
+
+fat_side_t* fat_side_create(uint64_t volume, uint32_t tag)
+{
+    fat_side_t* side = (fat_side_t*)calloc(1, sizeof(fat_side_t));
+    if (side == NULL)
+    {
+        printf("fat sidecar create failed.\r\n");
+        return NULL;
+    }
+    side->buckets = (fat_side_rec_t**)calloc(FAT_SIDE_BUCKETS, sizeof(fat_side_rec_t*));
+    if (side->buckets == NULL)
+    {
+        printf("fat sidecar create failed.\r\n");
+        free(side);
+        return NULL;
+    }
+    side->volume = volume;
+    side->tag = tag;
+    fat_mutex_init(&side->lock);
+    return side;
+}
+
+static bool fat_side_read(FILE* file, void* data, size_t size)
+{
+    return (fread(data, 1, size, file) == size);
+}
+
+fat_side_t* fat_side_load(const char* path, uint64_t volume, uint32_t tag)
+{
+    FILE* file = NULL;
+    fat_side_t* side = NULL;
+    fat_side_t* load = NULL;
+    fat_side_rec_t rec = { 0 };
+    char magic[8] = { 0 };
+    uint64_t file_volume = 0;
+    uint32_t file_tag = 0;
+    uint32_t count = 0;
+    uint32_t index = 0;
+    bool valid = false;
+
+    side = fat_side_create(volume, tag);
+    file = (side != NULL) ? fopen(path, "rb") : NULL;
+    // no sidecar yet, every region is parsed.
+    if (file == NULL)
+    {
+        return side;
+    }
+    load = fat_side_create(volume, tag);
+    valid = (load != NULL) && fat_side_read(file, magic, 8) && (memcmp(magic, FAT_SIDE_MAGIC, 8) == 0) &&
+        fat_side_read(file, &file_volume, sizeof(file_volume)) && (file_volume == volume) &&
+        fat_side_read(file, &file_tag, sizeof(file_tag)) && (file_tag == tag) &&
+        fat_side_read(file, &load->fat_count, sizeof(load->fat_count));
+    if (valid && (load->fat_count > 0))
+    {
+        load->fat_hashes = (uint64_t*)malloc(load->fat_count * sizeof(uint64_t));
+        valid = (load->fat_hashes != NULL) && fat_side_read(file, load->fat_hashes, load->fat_count * sizeof(uint64_t));
+    }
+    valid = valid && fat_side_read(file, &count, sizeof(count));
+    for (index = 0; valid && (index < count); index++)
+    {
+        valid = fat_side_read(file, &rec.key, sizeof(rec.key)) && fat_side_read(file, &rec.count, sizeof(rec.count)) &&
+            fat_side_read(file, &rec.hash, sizeof(rec.hash)) && fat_side_read(file, &rec.size, sizeof(rec.size));
+        rec.data = valid ? (uint8_t*)malloc((rec.size > 0) ? rec.size : 1) : NULL;
+        valid = (rec.data != NULL) && fat_side_read(file, rec.data, rec.size) &&
+            (fat_side_put(load, rec.key, rec.count, rec.hash, rec.data, rec.size) == 0);
+        free(rec.data);
+    }
+    // a sidecar cut short by a crash is ignored as a whole.
+    valid = valid && fat_side_read(file, magic, 8) && (memcmp(magic, FAT_SIDE_TAIL, 8) == 0);
+    fclose(file);
+    if (!valid)
+    {
+        fat_side_free(load);
+        return side;
+    }
+    fat_side_free(side);
+    return load;
+}
+
+fat_side_rec_t* fat_side_find(fat_side_t* side, uint32_t key)
+{
+    fat_side_rec_t* rec = NULL;
+    for (rec = side->buckets[key % FAT_SIDE_BUCKETS]; rec != NULL; rec = rec->next)
+    {
+        if (rec->key == key)
+        {
+            break;
+        }
+    }
+    return rec;
+}
+
+int fat_side_put(fat_side_t* side, uint32_t key, uint32_t count, uint64_t hash, const uint8_t* data, uint32_t size)
+{
+    fat_side_rec_t* rec = (fat_side_rec_t*)calloc(1, sizeof(fat_side_rec_t));
+    fat_side_rec_t** bucket = &side->buckets[key % FAT_SIDE_BUCKETS];
+
+    if (rec != NULL)
+    {
+        rec->data = (uint8_t*)malloc((size > 0) ? size : 1);
+    }
+    if ((rec == NULL) || (rec->data == NULL))
+    {
+        printf("fat sidecar record malloc failed.\r\n");
+        free(rec);
+        return -1;
+    }
+    rec->key = key;
+    rec->count = count;
+    rec->hash = hash;
+    rec->size = size;
+    memcpy(rec->data, data, size);
+    // records are put from the traversal pool.
+    fat_mutex_lock(&side->lock);
+    rec->next = *bucket;
+    *bucket = rec;
+    side->count = side->count + 1;
+    fat_mutex_unlock(&side->lock);
+    return 0;
+}
+
+int fat_side_save(fat_side_t* side, const char* path)
+{
+    FILE* file = NULL;
+    char* temp = NULL;
+    size_t size = strlen(path) + 5;
+    uint32_t bucket = 0;
+    bool failed = false;
+    fat_side_rec_t* rec = NULL;
+
+    temp = (char*)malloc(size);
+    if (temp == NULL)
+    {
+        return -1;
+    }
+    // write aside and rename, the old sidecar stays valid until the new one is complete.
+    snprintf(temp, size, "%s.tmp", path);
+    file = fopen(temp, "wb");
+    if (file == NULL)
+    {
+        printf("fat sidecar %s open failed.\r\n", temp);
+        free(temp);
+        return -1;
+    }
+    failed = (fwrite(FAT_SIDE_MAGIC, 1, 8, file) != 8) ||
+        (fwrite(&side->volume, sizeof(side->volume), 1, file) != 1) ||
+        (fwrite(&side->tag, sizeof(side->tag), 1, file) != 1) ||
+        (fwrite(&side->fat_count, sizeof(side->fat_count), 1, file) != 1) ||
+        ((side->fat_count > 0) && (fwrite(side->fat_hashes, sizeof(uint64_t), side->fat_count, file) != side->fat_count)) ||
+        (fwrite(&side->count, sizeof(side->count), 1, file) != 1);
+    for (bucket = 0; (bucket < FAT_SIDE_BUCKETS) && !failed; bucket++)
+    {
+        for (rec = side->buckets[bucket]; (rec != NULL) && !failed; rec = rec->next)
+        {
+            failed = (fwrite(&rec->key, sizeof(rec->key), 1, file) != 1) ||
+                (fwrite(&rec->count, sizeof(rec->count), 1, file) != 1) ||
+                (fwrite(&rec->hash, sizeof(rec->hash), 1, file) != 1) ||
+                (fwrite(&rec->size, sizeof(rec->size), 1, file) != 1) ||
+                (fwrite(rec->data, 1, rec->size, file) != rec->size);
+        }
+    }
+    failed = failed || (fwrite(FAT_SIDE_TAIL, 1, 8, file) != 8);
+    failed = (fclose(file) != 0) || failed;
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (failed || (rename(temp, path) != 0))
+    {
+        printf("fat sidecar %s write failed.\r\n", path);
+        remove(temp);
+        free(temp);
+        return -1;
+    }
+    free(temp);
+    return 0;
+}
+
+void fat_side_free(fat_side_t* side)
+{
+    uint32_t bucket = 0;
+    fat_side_rec_t* rec = NULL;
+    if (side == NULL)
+    {
+        return;
+    }
+    for (bucket = 0; bucket < FAT_SIDE_BUCKETS; bucket++)
+    {
+        while (side->buckets[bucket] != NULL)
+        {
+            rec = side->buckets[bucket];
+            side->buckets[bucket] = rec->next;
+            free(rec->data);
+            free(rec);
+        }
+    }
+    free(side->buckets);
+    free(side->fat_hashes);
+    fat_mutex_free(&side->lock);
+    free(side);
+}
@@ -0,0 +1,47 @@
+// fathash.h : fat check region hash and sidecar map header file
+#ifndef __FATHASH_H__
+#define __FATHASH_H__
+
+#include "fatpool.h"
+
+// sidecar markers, the tail marker is written last
+#define FAT_SIDE_MAGIC      "FATSIDE1"
+#define FAT_SIDE_TAIL       "FATSIDEK"
+// record hash buckets
+#define FAT_SIDE_BUCKETS    (0x1000)
+
+typedef struct fat_side_rec
+{
+    // region key, number of units hashed and their chained hash.
+    uint32_t key;
+    uint32_t count;
+    uint64_t hash;
+    // results derived from the region, opaque to the map.
+    uint8_t* data;
+    uint32_t size;
+    struct fat_side_rec* next;
+} fat_side_rec_t;
+
+typedef struct fat_side
+{
+    // records of another volume or layout are never loaded.
+    uint64_t volume;
+    uint32_t tag;
+    fat_side_rec_t** buckets;
+    uint32_t count;
+    // one hash per FAT sector.
+    uint64_t* fat_hashes;
+    uint32_t fat_count;
+    fat_mutex_t lock;
+} fat_side_t;
+
+uint64_t fat_hash64(const void* data, size_t size, uint64_t seed);
+
+fat_side_t* fat_side_create(uint64_t volume, uint32_t tag);
+fat_side_t* fat_side_load(const char* path, uint64_t volume, uint32_t tag);
+fat_side_rec_t* fat_side_find(fat_side_t* side, uint32_t key);
+int fat_side_put(fat_side_t* side, uint32_t key, uint32_t count, uint64_t hash, const uint8_t* data, uint32_t size);
+int fat_side_save(fat_side_t* side, const char* path);
+void fat_side_free(fat_side_t* side);
+
+#endif /* __FATHASH_H__ */
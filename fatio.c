@@ -0,0 +1,337 @@
+// fatio.c : fat asynchronous batch read source file
+#include "fatio.h"
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define FAT_IO_URING
+#endif
+#endif
+#ifdef FAT_IO_URING
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+typedef struct fat_ring
+{
+    int fd;
+    uint32_t entries;
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t* sq_mask;
+    uint32_t* sq_array;
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    uint8_t* sq_ptr;
+    uint8_t* cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqe_size;
+} fat_ring_t;
+
+static void fat_ring_free(fat_ring_t* ring)
+{
+    if (ring == NULL)
+    {
+        return;
+    }
+    if (ring->sqes != NULL)
+    {
+        munmap(ring->sqes, ring->sqe_size);
+    }
+    if ((ring->cq_ptr != NULL) && (ring->cq_ptr != ring->sq_ptr))
+    {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if (ring->sq_ptr != NULL)
+    {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    if (ring->fd >= 0)
+    {
+        close(ring->fd);
+    }
+    free(ring);
+}
+
+static fat_ring_t* fat_ring_create(uint32_t depth)
+{
+    struct io_uring_params params;
+    fat_ring_t* ring = (fat_ring_t*)calloc(1, sizeof(fat_ring_t));
+    void* ptr = NULL;
+
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, depth, &params);
+    if (ring->fd < 0)
+    {
+        free(ring);
+        return NULL;
+    }
+    ring->entries = params.sq_entries;
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // newer kernels share one mapping for both rings.
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->sq_size = (ring->sq_size > ring->cq_size) ? ring->sq_size : ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+    ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED)
+    {
+        fat_ring_free(ring);
+        return NULL;
+    }
+    ring->sq_ptr = (uint8_t*)ptr;
+    ring->cq_ptr = ring->sq_ptr;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED)
+        {
+            ring->cq_ptr = NULL;
+            fat_ring_free(ring);
+            return NULL;
+        }
+        ring->cq_ptr = (uint8_t*)ptr;
+    }
+    ring->sqe_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ptr = mmap(NULL, ring->sqe_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED)
+    {
+        fat_ring_free(ring);
+        return NULL;
+    }
+    ring->sqes = (struct io_uring_sqe*)ptr;
+    ring->sq_head = (uint32_t*)(ring->sq_ptr + params.sq_off.head);
+    ring->sq_tail = (uint32_t*)(ring->sq_ptr + params.sq_off.tail);
+    ring->sq_mask = (uint32_t*)(ring->sq_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (uint32_t*)(ring->sq_ptr + params.sq_off.array);
+    ring->cq_head = (uint32_t*)(ring->cq_ptr + params.cq_off.head);
+    ring->cq_tail = (uint32_t*)(ring->cq_ptr + params.cq_off.tail);
+    ring->cq_mask = (uint32_t*)(ring->cq_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(ring->cq_ptr + params.cq_off.cqes);
+    return ring;
+}
+
+static int fat_ring_read(fat_io_t* io, uint32_t count)
+{
+    fat_ring_t* ring = (fat_ring_t*)io->ring;
+    fat_dev_t* root = io->device;
+    uint64_t base = 0;
+    uint32_t next = 0;
+    uint32_t done = 0;
+    uint32_t flight = 0;
+    uint32_t submit = 0;
+    uint32_t tail = 0;
+    uint32_t head = 0;
+    uint32_t slot = 0;
+    int result = 0;
+    fat_io_req_t* req = NULL;
+    struct io_uring_sqe* sqe = NULL;
+    struct io_uring_cqe* cqe = NULL;
+
+    // windows read straight from the file of their root device.
+    for (root = io->device; root->parent != NULL; root = root->parent)
+    {
+        base = base + root->base;
+    }
+    while (done < count)
+    {
+        // keep the ring full up to the queue depth.
+        tail = *ring->sq_tail;
+        while ((next < count) && (flight < io->depth) && (flight < ring->entries))
+        {
+            req = &io->reqs[next];
+            slot = tail & *ring->sq_mask;
+            sqe = &ring->sqes[slot];
+            memset(sqe, 0, sizeof(struct io_uring_sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = root->file_hand;
+            sqe->off = base + req->offset;
+            sqe->addr = (uint64_t)(uintptr_t)req->buff;
+            sqe->len = req->size;
+            sqe->user_data = next;
+            ring->sq_array[slot] = slot;
+            tail = tail + 1;
+            next = next + 1;
+            flight = flight + 1;
+        }
+        __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+        // a signal interrupts the wait, enter again with the entries the kernel has not consumed.
+        do
+        {
+            submit = tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+            result = (int)syscall(__NR_io_uring_enter, ring->fd, submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        } while ((result < 0) && (errno == EINTR));
+        if (result < 0)
+        {
+            printf("fat io ring enter failed, errno %d.\r\n", errno);
+            return -1;
+        }
+        // process completions in the order they arrive.
+        head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        {
+            cqe = &ring->cqes[head & *ring->cq_mask];
+            req = &io->reqs[cqe->user_data];
+            req->result = cqe->res;
+            // kernels without IORING_OP_READ, read it the plain way.
+            if (req->result == -EINVAL)
+            {
+                req->result = fat_dev_pread(io->device, req->offset, req->buff, req->size);
+            }
+            if (req->result != (int)req->size)
+            {
+                io->errors = io->errors + 1;
+            }
+            if (io->done != NULL)
+            {
+                io->done(io, req);
+            }
+            head = head + 1;
+            flight = flight - 1;
+            done = done + 1;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+#endif
+
+static void fat_io_task(fat_pool_t* pool, int worker, void* arg)
+{
+    fat_io_t* io = (fat_io_t*)pool->user;
+    uint32_t count = (uint32_t)(uintptr_t)arg;
+    fat_io_req_t* req = NULL;
+    long index = 0;
+
+    (void)worker;
+    // every pool worker is one in flight read.
+    while (true)
+    {
+        index = fat_atomic_add(&io->next, 1) - 1;
+        if (index >= (long)count)
+        {
+            break;
+        }
+        req = &io->reqs[index];
+        req->result = fat_dev_pread(io->device, req->offset, req->buff, req->size);
+        if (req->result != (int)req->size)
+        {
+            fat_atomic_add(&io->errors, 1);
+        }
+        if (io->done != NULL)
+        {
+            io->done(io, req);
+        }
+    }
+}
+
+fat_io_t* fat_io_create(fat_dev_t* device, uint32_t depth, void* user)
+{
+    fat_io_t* io = NULL;
+    if (device == NULL)
+    {
+        printf("fat io create failed, parameter is null.\r\n");
+        return NULL;
+    }
+    io = (fat_io_t*)calloc(1, sizeof(fat_io_t));
+    if (io == NULL)
+    {
+        printf("fat io create failed.\r\n");
+        return NULL;
+    }
+    depth = (depth == 0) ? FAT_IO_DEPTH_DEFAULT : depth;
+    io->depth = (depth > FAT_IO_DEPTH_MAX) ? FAT_IO_DEPTH_MAX : depth;
+    io->device = device;
+    io->user = user;
+#ifdef FAT_IO_URING
+    io->ring = fat_ring_create(io->depth);
+    if (io->ring != NULL)
+    {
+        io->backend = FAT_IO_BACKEND_URING;
+        return io;
+    }
+#endif
+    // no kernel ring, emulate the queue with pread on pool threads, started once and reused by every batch.
+    io->backend = FAT_IO_BACKEND_POOL;
+    io->pool = fat_pool_create((int)io->depth, io);
+    if (io->pool == NULL)
+    {
+        printf("fat io pool create failed.\r\n");
+        free(io);
+        return NULL;
+    }
+    return io;
+}
+
+const char* fat_io_name(fat_io_t* io)
+{
+    return (io->backend == FAT_IO_BACKEND_URING) ? "io_uring" : "pool";
+}
+
+int fat_io_read(fat_io_t* io, fat_io_req_t* reqs, uint32_t count, fat_io_done_fn done)
+{
+    uint32_t index = 0;
+    uint32_t workers = 0;
+    if ((io == NULL) || (reqs == NULL))
+    {
+        printf("fat io read failed, parameter is null.\r\n");
+        return -1;
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+    for (index = 0; index < count; index++)
+    {
+        if ((reqs[index].offset > io->device->file_size) || (reqs[index].size > (io->device->file_size - reqs[index].offset)))
+        {
+            printf("fat io read at 0x%08llX is out of device.\r\n", (unsigned long long)reqs[index].offset);
+            return -1;
+        }
+    }
+    io->reqs = reqs;
+    io->done = done;
+    io->next = 0;
+    io->errors = 0;
+#ifdef FAT_IO_URING
+    if (io->backend == FAT_IO_BACKEND_URING)
+    {
+        if (fat_ring_read(io, count) < 0)
+        {
+            return -1;
+        }
+        return (io->errors > 0) ? -1 : 0;
+    }
+#endif
+    // completion callbacks may run on any pool worker.
+    workers = (count < io->depth) ? count : io->depth;
+    for (index = 0; index < workers; index++)
+    {
+        fat_pool_push(io->pool, 0, fat_io_task, (void*)(uintptr_t)count);
+    }
+    fat_pool_run(io->pool);
+    return (io->errors > 0) ? -1 : 0;
+}
+
+void fat_io_free(fat_io_t* io)
+{
+    if (io == NULL)
+    {
+        return;
+    }
+#ifdef FAT_IO_URING
+    fat_ring_free((fat_ring_t*)io->ring);
+#endif
+    fat_pool_free(io->pool);
+    free(io);
+}
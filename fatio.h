@@ -0,0 +1,47 @@
+// fatio.h : fat asynchronous batch read header file
+#ifndef __FATIO_H__
+#define __FATIO_H__
+
+#include "fatdev.h"
+
+// reads kept in flight by default, and the upper bound
+#define FAT_IO_DEPTH_DEFAULT    (32)
+#define FAT_IO_DEPTH_MAX        (0x400)
+
+// backend, io_uring on linux, otherwise pread on pool threads
+#define FAT_IO_BACKEND_POOL     (0)
+#define FAT_IO_BACKEND_URING    (1)
+
+typedef struct fat_io_req
+{
+    uint64_t offset;
+    uint8_t* buff;
+    uint32_t size;
+    // bytes read, or negative on failure.
+    int result;
+    void* user;
+} fat_io_req_t;
+
+struct fat_io;
+typedef void (*fat_io_done_fn)(struct fat_io* io, fat_io_req_t* req);
+
+typedef struct fat_io
+{
+    fat_dev_t* device;
+    int backend;
+    uint32_t depth;
+    void* ring;
+    fat_pool_t* pool;
+    fat_io_req_t* reqs;
+    fat_io_done_fn done;
+    volatile long next;
+    volatile long errors;
+    void* user;
+} fat_io_t;
+
+fat_io_t* fat_io_create(fat_dev_t* device, uint32_t depth, void* user);
+const char* fat_io_name(fat_io_t* io);
+int fat_io_read(fat_io_t* io, fat_io_req_t* reqs, uint32_t count, fat_io_done_fn done);
+void fat_io_free(fat_io_t* io);
+
+#endif /* __FATIO_H__ */
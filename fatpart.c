@@ -0,0 +1,193 @@
+// fatpart.c : fat partition layout manifest source file
+#include "fatpart.h"
+#include <ctype.h>
+#include <stdbool.h>
+
+// white space between xml tokens
+#define FAT_LAYOUT_SPACE    " \t\r\n"
+
+// blank out comments, a tag inside one is not part of the layout.
+static int fat_layout_uncomment(char* text)
+{
+    char* open = text;
+    char* close = NULL;
+    while ((open = strstr(open, "<!--")) != NULL)
+    {
+        close = strstr(open + 4, "-->");
+        if (close == NULL)
+        {
+            printf("fat layout comment is not closed.\r\n");
+            return -1;
+        }
+        memset(open, ' ', (size_t)(close + 3 - open));
+        open = close + 3;
+    }
+    return 0;
+}
+
+static bool fat_layout_name_char(char value)
+{
+    return (isalnum((unsigned char)value) || (value == '_') || (value == '-') || (value == '.') || (value == ':'));
+}
+
+// find token inside [start, end) where neither neighbour continues a name, "name" never matches "filename".
+static const char* fat_layout_token(const char* start, const char* end, const char* token)
+{
+    size_t size = strlen(token);
+    const char* text = start;
+    while (((text = strstr(text, token)) != NULL) && (text + size <= end))
+    {
+        if (((text == start) || !fat_layout_name_char(text[-1])) && !fat_layout_name_char(text[size]))
+        {
+            return text;
+        }
+        text = text + 1;
+    }
+    return NULL;
+}
+
+// get the number of <tag>...</tag> inside [start, end), the element holds nothing else.
+static int fat_layout_value(const char* start, const char* end, const char* tag, uint64_t* value)
+{
+    char open_tag[FAT_PART_NAME_SIZE] = { 0 };
+    char close_tag[FAT_PART_NAME_SIZE] = { 0 };
+    const char* text = NULL;
+    char* stop = NULL;
+
+    snprintf(open_tag, sizeof(open_tag), "<%s", tag);
+    snprintf(close_tag, sizeof(close_tag), "</%s>", tag);
+    text = fat_layout_token(start, end, open_tag);
+    if (text == NULL)
+    {
+        return -1;
+    }
+    text = text + strlen(open_tag);
+    text = text + strspn(text, FAT_LAYOUT_SPACE);
+    if (*text != '>')
+    {
+        return -1;
+    }
+    text = text + 1;
+    text = text + strspn(text, FAT_LAYOUT_SPACE);
+    // strtoull would take a sign, a negative size wraps around.
+    if (!isdigit((unsigned char)*text))
+    {
+        return -1;
+    }
+    *value = strtoull(text, &stop, 0);
+    stop = stop + strspn(stop, FAT_LAYOUT_SPACE);
+    if ((stop == text) || (strncmp(stop, close_tag, strlen(close_tag)) != 0) || (stop >= end))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int fat_layout_parse(fat_layout_t* layout, char* text)
+{
+    const char* bin = text;
+    const char* last = text + strlen(text);
+    const char* head = NULL;
+    const char* end = NULL;
+    const char* name = NULL;
+    size_t size = 0;
+    fat_part_t* parts = NULL;
+    fat_part_t* part = NULL;
+
+    if (fat_layout_uncomment(text) < 0)
+    {
+        return -1;
+    }
+    // each <bin name="..."> carries one <offset> and one <length>.
+    while ((bin = fat_layout_token(bin, last, "<bin")) != NULL)
+    {
+        head = strchr(bin, '>');
+        end = strstr(bin, "</bin>");
+        if ((head == NULL) || (end == NULL) || (head > end))
+        {
+            printf("fat layout bin tag is not closed.\r\n");
+            return -1;
+        }
+        parts = (fat_part_t*)realloc(layout->parts, (layout->part_count + 1) * sizeof(fat_part_t));
+        if (parts == NULL)
+        {
+            printf("fat layout malloc failed.\r\n");
+            return -1;
+        }
+        layout->parts = parts;
+        part = &layout->parts[layout->part_count];
+        memset(part, 0, sizeof(fat_part_t));
+        // the name attribute of the opening tag, name = "..." with spaces is allowed.
+        name = fat_layout_token(bin + strlen("<bin"), head, "name");
+        if (name != NULL)
+        {
+            name = name + strlen("name");
+            name = name + strspn(name, FAT_LAYOUT_SPACE);
+            name = (*name == '=') ? (name + 1 + strspn(name + 1, FAT_LAYOUT_SPACE)) : NULL;
+        }
+        if ((name != NULL) && (*name == '"'))
+        {
+            name = name + 1;
+            size = strcspn(name, "\">");
+            size = (size < (FAT_PART_NAME_SIZE - 1)) ? size : (FAT_PART_NAME_SIZE - 1);
+            memcpy(part->name, name, size);
+        }
+        if ((fat_layout_value(head, end, "offset", &part->offset) < 0) ||
+            (fat_layout_value(head, end, "length", &part->length) < 0) || (part->length == 0))
+        {
+            printf("fat layout bin %s has no offset or length.\r\n", part->name);
+            return -1;
+        }
+        layout->part_count = layout->part_count + 1;
+        bin = end + strlen("</bin>");
+    }
+    return 0;
+}
+
+fat_layout_t* fat_layout_load(const char* path)
+{
+    FILE* file = NULL;
+    char* text = NULL;
+    long size = 0;
+    fat_layout_t* layout = NULL;
+
+    file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("fat layout %s open failed.\r\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    text = (char*)calloc(1, (size > 0) ? (size + 1) : 1);
+    layout = (fat_layout_t*)calloc(1, sizeof(fat_layout_t));
+    if ((text == NULL) || (layout == NULL) || (size <= 0) || (fread(text, 1, size, file) != (size_t)size))
+    {
+        printf("fat layout %s read failed.\r\n", path);
+        fclose(file);
+        free(text);
+        free(layout);
+        return NULL;
+    }
+    fclose(file);
+    if ((fat_layout_parse(layout, text) < 0) || (layout->part_count == 0))
+    {
+        printf("fat layout %s has no partition.\r\n", path);
+        free(text);
+        fat_layout_free(layout);
+        return NULL;
+    }
+    free(text);
+    return layout;
+}
+
+void fat_layout_free(fat_layout_t* layout)
+{
+    if (layout == NULL)
+    {
+        return;
+    }
+    free(layout->parts);
+    free(layout);
+}
@@ -0,0 +1,29 @@
+// fatpart.h : fat partition layout manifest header file
+#ifndef __FATPART_H__
+#define __FATPART_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// partition name buffer length
+#define FAT_PART_NAME_SIZE  (0x40)
+
+typedef struct fat_part
+{
+    char name[FAT_PART_NAME_SIZE];
+    uint64_t offset;
+    uint64_t length;
+} fat_part_t;
+
+typedef struct fat_layout
+{
+    fat_part_t* parts;
+    uint32_t part_count;
+} fat_layout_t;
+
+fat_layout_t* fat_layout_load(const char* path);
+void fat_layout_free(fat_layout_t* layout);
+
+#endif /* __FATPART_H__ */
@@ -0,0 +1,384 @@
+// fatpool.c : fat work-stealing thread pool source file
+#include "fatpool.h"
+#ifndef _WIN32
+#include <time.h>
+#include <unistd.h>
+#endif
+
+typedef struct fat_worker
+{
+    fat_pool_t* pool;
+    int worker;
+} fat_worker_t;
+
+void fat_mutex_init(fat_mutex_t* mutex)
+{
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void fat_mutex_lock(fat_mutex_t* mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void fat_mutex_unlock(fat_mutex_t* mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void fat_mutex_free(fat_mutex_t* mutex)
+{
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+long fat_atomic_add(volatile long* value, long delta)
+{
+#ifdef _WIN32
+    return InterlockedExchangeAdd(value, delta) + delta;
+#else
+    return __atomic_add_fetch(value, delta, __ATOMIC_SEQ_CST);
+#endif
+}
+
+uint64_t fat_atomic_add64(volatile uint64_t* value, uint64_t delta)
+{
+#ifdef _WIN32
+    return (uint64_t)InterlockedExchangeAdd64((volatile LONG64*)value, (LONG64)delta) + delta;
+#else
+    return __atomic_add_fetch(value, delta, __ATOMIC_SEQ_CST);
+#endif
+}
+
+int fat_cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+#endif
+}
+
+uint64_t fat_time_us(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count;
+    LARGE_INTEGER freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000 + (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+#endif
+}
+
+static void fat_cond_init(fat_cond_t* cond)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+static void fat_cond_wait(fat_cond_t* cond, fat_mutex_t* mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+static void fat_cond_wake(fat_cond_t* cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+static void fat_cond_free(fat_cond_t* cond)
+{
+#ifdef _WIN32
+    (void)cond;
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+fat_pool_t* fat_pool_create(int thread_count, void* user)
+{
+    int index = 0;
+    fat_pool_t* pool = NULL;
+
+    thread_count = (thread_count > 0) ? thread_count : fat_cpu_count();
+    pool = (fat_pool_t*)calloc(1, sizeof(fat_pool_t));
+    if (pool == NULL)
+    {
+        printf("fat pool create failed.\r\n");
+        return NULL;
+    }
+    pool->deques = (fat_deque_t*)calloc(thread_count, sizeof(fat_deque_t));
+    if (pool->deques == NULL)
+    {
+        printf("fat pool deque create failed.\r\n");
+        free(pool);
+        return NULL;
+    }
+    for (index = 0; index < thread_count; index++)
+    {
+        fat_mutex_init(&pool->deques[index].lock);
+    }
+    fat_mutex_init(&pool->wait_lock);
+    fat_cond_init(&pool->wait_cond);
+    pool->thread_count = thread_count;
+    pool->user = user;
+    return pool;
+}
+
+// wake the sleeping workers, a worker going to sleep counts itself idle before it looks for tasks.
+static void fat_pool_wake(fat_pool_t* pool)
+{
+    if (fat_atomic_add(&pool->idle, 0) > 0)
+    {
+        fat_mutex_lock(&pool->wait_lock);
+        fat_cond_wake(&pool->wait_cond);
+        fat_mutex_unlock(&pool->wait_lock);
+    }
+}
+
+static bool fat_pool_ready(fat_pool_t* pool)
+{
+    int index = 0;
+    bool ready = false;
+    for (index = 0; (index < pool->thread_count) && !ready; index++)
+    {
+        fat_mutex_lock(&pool->deques[index].lock);
+        ready = (pool->deques[index].tail > pool->deques[index].head);
+        fat_mutex_unlock(&pool->deques[index].lock);
+    }
+    return ready;
+}
+
+int fat_pool_push(fat_pool_t* pool, int worker, fat_task_fn func, void* arg)
+{
+    fat_deque_t* deque = &pool->deques[worker];
+    fat_task_t* tasks = NULL;
+    uint32_t limit = 0;
+
+    fat_atomic_add(&pool->pending, 1);
+    fat_mutex_lock(&deque->lock);
+    if (deque->tail >= deque->limit)
+    {
+        // reuse the stolen head slots before growing.
+        if (deque->head > 0)
+        {
+            memmove(deque->tasks, deque->tasks + deque->head, (deque->tail - deque->head) * sizeof(fat_task_t));
+            deque->tail = deque->tail - deque->head;
+            deque->head = 0;
+        }
+        if (deque->tail >= deque->limit)
+        {
+            limit = (deque->limit == 0) ? FAT_POOL_DEQUE_SIZE : (deque->limit * 2);
+            tasks = (fat_task_t*)realloc(deque->tasks, limit * sizeof(fat_task_t));
+            if (tasks == NULL)
+            {
+                fat_mutex_unlock(&deque->lock);
+                fat_atomic_add(&pool->pending, -1);
+                printf("fat pool task push failed.\r\n");
+                return -1;
+            }
+            deque->tasks = tasks;
+            deque->limit = limit;
+        }
+    }
+    deque->tasks[deque->tail].func = func;
+    deque->tasks[deque->tail].arg = arg;
+    deque->tail = deque->tail + 1;
+    fat_mutex_unlock(&deque->lock);
+    fat_pool_wake(pool);
+    return 0;
+}
+
+static bool fat_pool_take(fat_pool_t* pool, int worker, fat_task_t* task)
+{
+    int index = 0;
+    fat_deque_t* deque = &pool->deques[worker];
+
+    // own deque is used as a stack, newest task first.
+    fat_mutex_lock(&deque->lock);
+    if (deque->tail > deque->head)
+    {
+        deque->tail = deque->tail - 1;
+        *task = deque->tasks[deque->tail];
+        fat_mutex_unlock(&deque->lock);
+        return true;
+    }
+    fat_mutex_unlock(&deque->lock);
+    // steal the oldest task of another worker.
+    for (index = 1; index < pool->thread_count; index++)
+    {
+        deque = &pool->deques[(worker + index) % pool->thread_count];
+        fat_mutex_lock(&deque->lock);
+        if (deque->tail > deque->head)
+        {
+            *task = deque->tasks[deque->head];
+            deque->head = deque->head + 1;
+            fat_mutex_unlock(&deque->lock);
+            return true;
+        }
+        fat_mutex_unlock(&deque->lock);
+    }
+    return false;
+}
+
+static void fat_pool_wait(fat_pool_t* pool)
+{
+    fat_mutex_lock(&pool->wait_lock);
+    fat_atomic_add(&pool->idle, 1);
+    while ((fat_atomic_add(&pool->pending, 0) > 0) && !fat_pool_ready(pool))
+    {
+        fat_cond_wait(&pool->wait_cond, &pool->wait_lock);
+    }
+    fat_atomic_add(&pool->idle, -1);
+    fat_mutex_unlock(&pool->wait_lock);
+}
+
+static void fat_pool_work(fat_pool_t* pool, int worker)
+{
+    fat_task_t task = { 0 };
+    while (true)
+    {
+        if (fat_pool_take(pool, worker, &task))
+        {
+            task.func(pool, worker, task.arg);
+            // the last completion releases the workers waiting for a task.
+            if (fat_atomic_add(&pool->pending, -1) == 0)
+            {
+                fat_pool_wake(pool);
+            }
+        }
+        else if (fat_atomic_add(&pool->pending, 0) == 0)
+        {
+            break;
+        }
+        else
+        {
+            fat_pool_wait(pool);
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI fat_pool_thread(LPVOID arg)
+#else
+static void* fat_pool_thread(void* arg)
+#endif
+{
+    fat_worker_t* worker = (fat_worker_t*)arg;
+    fat_pool_t* pool = worker->pool;
+    bool stop = false;
+    while (!stop)
+    {
+        fat_pool_work(pool, worker->worker);
+        // parked between runs, a push or the pool free wakes it.
+        fat_mutex_lock(&pool->wait_lock);
+        fat_atomic_add(&pool->idle, 1);
+        while ((pool->stop == 0) && (fat_atomic_add(&pool->pending, 0) == 0))
+        {
+            fat_cond_wait(&pool->wait_cond, &pool->wait_lock);
+        }
+        fat_atomic_add(&pool->idle, -1);
+        stop = (pool->stop != 0);
+        fat_mutex_unlock(&pool->wait_lock);
+    }
+    return 0;
+}
+
+int fat_pool_run(fat_pool_t* pool)
+{
+    int index = 0;
+
+    if ((pool->thread_count > 1) && (pool->threads == NULL) && (pool->workers == NULL))
+    {
+        pool->threads = (fat_thread_t*)calloc(pool->thread_count, sizeof(fat_thread_t));
+        pool->workers = (fat_worker_t*)calloc(pool->thread_count, sizeof(fat_worker_t));
+        // worker 0 is the calling thread, it runs alone when threads are missing.
+        for (index = 1; (pool->threads != NULL) && (pool->workers != NULL) && (index < pool->thread_count); index++)
+        {
+            pool->workers[index].pool = pool;
+            pool->workers[index].worker = index;
+#ifdef _WIN32
+            pool->threads[index] = CreateThread(NULL, 0, fat_pool_thread, &pool->workers[index], 0, NULL);
+            if (pool->threads[index] == NULL)
+            {
+                break;
+            }
+#else
+            if (pthread_create(&pool->threads[index], NULL, fat_pool_thread, &pool->workers[index]) != 0)
+            {
+                break;
+            }
+#endif
+            pool->thread_started = pool->thread_started + 1;
+        }
+    }
+    // the run ends with the last task, the started threads stay parked for the next one.
+    fat_pool_work(pool, 0);
+    return 0;
+}
+
+void fat_pool_free(fat_pool_t* pool)
+{
+    int index = 0;
+    if (pool == NULL)
+    {
+        return;
+    }
+    fat_mutex_lock(&pool->wait_lock);
+    pool->stop = 1;
+    fat_cond_wake(&pool->wait_cond);
+    fat_mutex_unlock(&pool->wait_lock);
+    for (index = 1; index <= pool->thread_started; index++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[index], INFINITE);
+        CloseHandle(pool->threads[index]);
+#else
+        pthread_join(pool->threads[index], NULL);
+#endif
+    }
+    free(pool->threads);
+    free(pool->workers);
+    for (index = 0; index < pool->thread_count; index++)
+    {
+        fat_mutex_free(&pool->deques[index].lock);
+        free(pool->deques[index].tasks);
+    }
+    fat_mutex_free(&pool->wait_lock);
+    fat_cond_free(&pool->wait_cond);
+    free(pool->deques);
+    free(pool);
+}
@@ -0,0 +1,79 @@
+// fatpool.h : fat work-stealing thread pool header file
+#ifndef __FATPOOL_H__
+#define __FATPOOL_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION fat_mutex_t;
+typedef CONDITION_VARIABLE fat_cond_t;
+typedef HANDLE fat_thread_t;
+#else
+typedef pthread_mutex_t fat_mutex_t;
+typedef pthread_cond_t fat_cond_t;
+typedef pthread_t fat_thread_t;
+#endif
+
+// initial task slots of each worker deque
+#define FAT_POOL_DEQUE_SIZE (0x40)
+
+struct fat_pool;
+struct fat_worker;
+typedef void (*fat_task_fn)(struct fat_pool* pool, int worker, void* arg);
+
+typedef struct fat_task
+{
+    fat_task_fn func;
+    void* arg;
+} fat_task_t;
+
+typedef struct fat_deque
+{
+    fat_mutex_t lock;
+    fat_task_t* tasks;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t limit;
+} fat_deque_t;
+
+typedef struct fat_pool
+{
+    fat_deque_t* deques;
+    int thread_count;
+    volatile long pending;
+    // workers without a task sleep here until a push or the last completion.
+    fat_mutex_t wait_lock;
+    fat_cond_t wait_cond;
+    volatile long idle;
+    // worker threads are started by the first run and live until the pool is freed.
+    fat_thread_t* threads;
+    struct fat_worker* workers;
+    int thread_started;
+    volatile long stop;
+    void* user;
+} fat_pool_t;
+
+void fat_mutex_init(fat_mutex_t* mutex);
+void fat_mutex_lock(fat_mutex_t* mutex);
+void fat_mutex_unlock(fat_mutex_t* mutex);
+void fat_mutex_free(fat_mutex_t* mutex);
+long fat_atomic_add(volatile long* value, long delta);
+uint64_t fat_atomic_add64(volatile uint64_t* value, uint64_t delta);
+int fat_cpu_count(void);
+uint64_t fat_time_us(void);
+
+fat_pool_t* fat_pool_create(int thread_count, void* user);
+int fat_pool_push(fat_pool_t* pool, int worker, fat_task_fn func, void* arg);
+int fat_pool_run(fat_pool_t* pool);
+void fat_pool_free(fat_pool_t* pool);
+
+#endif /* __FATPOOL_H__ */
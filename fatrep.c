@@ -0,0 +1,267 @@
+// fatrep.c : fat check report writer source file
+#include "fatrep.h"
+
+static bool fat_rep_reserve(fat_rep_t* rep, size_t size)
+{
+    size_t limit = 0;
+    char* buff = NULL;
+
+    if (rep->size + size + 1 <= rep->limit)
+    {
+        return true;
+    }
+    // a file backed report drains the buffer before it grows.
+    if ((rep->file != NULL) && (rep->size > 0))
+    {
+        fat_rep_flush(rep);
+        if (size + 1 <= rep->limit)
+        {
+            return true;
+        }
+    }
+    limit = (rep->limit == 0) ? FAT_REP_BUFF_SIZE : rep->limit;
+    while (rep->size + size + 1 > limit)
+    {
+        limit = limit * 2;
+    }
+    buff = (char*)realloc(rep->buff, limit);
+    if (buff == NULL)
+    {
+        return false;
+    }
+    rep->buff = buff;
+    rep->limit = limit;
+    return true;
+}
+
+static void fat_rep_vformat(fat_rep_t* rep, const char* format, va_list args)
+{
+    va_list copy;
+    int size = 0;
+
+    // format in place, retry once when the buffer is too small.
+    if (!fat_rep_reserve(rep, 0x100))
+    {
+        return;
+    }
+    va_copy(copy, args);
+    size = vsnprintf(rep->buff + rep->size, rep->limit - rep->size, format, copy);
+    va_end(copy);
+    if (size < 0)
+    {
+        return;
+    }
+    if (rep->size + size + 1 > rep->limit)
+    {
+        if (!fat_rep_reserve(rep, (size_t)size))
+        {
+            return;
+        }
+        vsnprintf(rep->buff + rep->size, rep->limit - rep->size, format, args);
+    }
+    rep->size = rep->size + size;
+}
+
+static void fat_rep_format(fat_rep_t* rep, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    fat_rep_vformat(rep, format, args);
+    va_end(args);
+}
+
+static void fat_rep_quote(fat_rep_t* rep, const char* value, size_t size)
+{
+    size_t index = 0;
+    unsigned char c = 0;
+
+    if (!fat_rep_reserve(rep, size * 6 + 2))
+    {
+        return;
+    }
+    // json string, control characters are escaped, utf-8 passes through.
+    rep->buff[rep->size++] = '"';
+    for (index = 0; index < size; index++)
+    {
+        c = (unsigned char)value[index];
+        if ((c == '"') || (c == '\\'))
+        {
+            rep->buff[rep->size++] = '\\';
+            rep->buff[rep->size++] = (char)c;
+        }
+        else if (c < 0x20)
+        {
+            rep->size = rep->size + snprintf(rep->buff + rep->size, 7, "\\u%04x", c);
+        }
+        else
+        {
+            rep->buff[rep->size++] = (char)c;
+        }
+    }
+    rep->buff[rep->size++] = '"';
+}
+
+void fat_rep_init(fat_rep_t* rep, int format, int level, FILE* file)
+{
+    memset(rep, 0, sizeof(fat_rep_t));
+    rep->format = format;
+    rep->level = level;
+    rep->file = file;
+}
+
+bool fat_rep_want(fat_rep_t* rep, int level)
+{
+    return (rep->level >= level);
+}
+
+void fat_rep_text(fat_rep_t* rep, int level, const char* format, ...)
+{
+    va_list args;
+    // layout only lines, machine readable output skips them.
+    if ((rep->format != FAT_REP_TEXT) || !fat_rep_want(rep, level))
+    {
+        return;
+    }
+    va_start(args, format);
+    fat_rep_vformat(rep, format, args);
+    va_end(args);
+}
+
+void fat_rep_note(fat_rep_t* rep, int level, const char* kind, const char* format, ...)
+{
+    va_list args;
+    int size = 0;
+    char* note = NULL;
+    char text[FAT_REP_NOTE_SIZE] = { 0 };
+
+    if (rep->hook != NULL)
+    {
+        va_start(args, format);
+        vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        rep->hook(rep->hook_user, level, kind, text);
+    }
+    if (!fat_rep_want(rep, level))
+    {
+        return;
+    }
+    va_start(args, format);
+    if (rep->format == FAT_REP_TEXT)
+    {
+        fat_rep_vformat(rep, format, args);
+        fat_rep_write(rep, "\r\n", 2);
+        va_end(args);
+        return;
+    }
+    // format the message aside, a flush while the record is built would move it in the buffer.
+    size = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (size < 0)
+    {
+        return;
+    }
+    note = text;
+    if ((size_t)size >= sizeof(text))
+    {
+        note = (char*)malloc((size_t)size + 1);
+        if (note == NULL)
+        {
+            return;
+        }
+        va_start(args, format);
+        vsnprintf(note, (size_t)size + 1, format, args);
+        va_end(args);
+    }
+    fat_rep_format(rep, "{\"type\":\"finding\",\"kind\":\"%s\",\"text\":", kind);
+    fat_rep_quote(rep, note, (size_t)size);
+    fat_rep_write(rep, "}\n", 2);
+    if (note != text)
+    {
+        free(note);
+    }
+}
+
+void fat_rep_begin(fat_rep_t* rep, int level, const char* type)
+{
+    rep->skip = !fat_rep_want(rep, level);
+    rep->fields = 0;
+    if (rep->skip || (rep->format != FAT_REP_JSON))
+    {
+        return;
+    }
+    fat_rep_format(rep, "{\"type\":\"%s\"", type);
+}
+
+void fat_rep_uint(fat_rep_t* rep, const char* key, const char* text, uint64_t value)
+{
+    if (rep->skip)
+    {
+        return;
+    }
+    rep->fields = rep->fields + 1;
+    if (rep->format == FAT_REP_JSON)
+    {
+        fat_rep_format(rep, ",\"%s\":%llu", key, (unsigned long long)value);
+    }
+    else if (text != NULL)
+    {
+        fat_rep_format(rep, text, (unsigned long long)value);
+    }
+}
+
+void fat_rep_str(fat_rep_t* rep, const char* key, const char* text, const char* value)
+{
+    if (rep->skip)
+    {
+        return;
+    }
+    rep->fields = rep->fields + 1;
+    if (rep->format == FAT_REP_JSON)
+    {
+        fat_rep_format(rep, ",\"%s\":", key);
+        fat_rep_quote(rep, value, strlen(value));
+    }
+    else if (text != NULL)
+    {
+        fat_rep_format(rep, text, value);
+    }
+}
+
+void fat_rep_end(fat_rep_t* rep)
+{
+    if (!rep->skip && (rep->format == FAT_REP_JSON))
+    {
+        fat_rep_write(rep, "}\n", 2);
+    }
+    rep->skip = false;
+}
+
+void fat_rep_write(fat_rep_t* rep, const char* data, size_t size)
+{
+    if ((size == 0) || !fat_rep_reserve(rep, size))
+    {
+        return;
+    }
+    memcpy(rep->buff + rep->size, data, size);
+    rep->size = rep->size + size;
+}
+
+void fat_rep_flush(fat_rep_t* rep)
+{
+    if ((rep->file == NULL) || (rep->size == 0))
+    {
+        return;
+    }
+    fwrite(rep->buff, 1, rep->size, rep->file);
+    fflush(rep->file);
+    rep->size = 0;
+}
+
+void fat_rep_free(fat_rep_t* rep)
+{
+    fat_rep_flush(rep);
+    free(rep->buff);
+    rep->buff = NULL;
+    rep->size = 0;
+    rep->limit = 0;
+}
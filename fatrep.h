@@ -0,0 +1,58 @@
+// fatrep.h : fat check report writer header file
+#ifndef __FATREP_H__
+#define __FATREP_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+
+// report format, text keeps the classic line per field layout
+#define FAT_REP_TEXT        (0)
+#define FAT_REP_JSON        (1)
+
+// verbosity, every level includes the ones below it, none formats nothing
+#define FAT_REP_NONE        (-1)
+#define FAT_REP_SUMMARY     (0)
+#define FAT_REP_FINDINGS    (1)
+#define FAT_REP_ENTRIES     (2)
+
+// output buffer, flushed to the file when it fills up
+#define FAT_REP_BUFF_SIZE   (0x40000)
+// longest note passed to the note hook
+#define FAT_REP_NOTE_SIZE   (0x200)
+
+typedef void (*fat_rep_hook_fn)(void* user, int level, const char* kind, const char* text);
+
+typedef struct fat_rep
+{
+    int format;
+    int level;
+    // a NULL file keeps the whole report in the buffer.
+    FILE* file;
+    char* buff;
+    size_t size;
+    size_t limit;
+    // state of the open record.
+    bool skip;
+    uint32_t fields;
+    // sees every note whatever the level, formatted only for it.
+    fat_rep_hook_fn hook;
+    void* hook_user;
+} fat_rep_t;
+
+void fat_rep_init(fat_rep_t* rep, int format, int level, FILE* file);
+bool fat_rep_want(fat_rep_t* rep, int level);
+void fat_rep_text(fat_rep_t* rep, int level, const char* format, ...);
+void fat_rep_note(fat_rep_t* rep, int level, const char* kind, const char* format, ...);
+void fat_rep_begin(fat_rep_t* rep, int level, const char* type);
+void fat_rep_uint(fat_rep_t* rep, const char* key, const char* text, uint64_t value);
+void fat_rep_str(fat_rep_t* rep, const char* key, const char* text, const char* value);
+void fat_rep_end(fat_rep_t* rep);
+void fat_rep_write(fat_rep_t* rep, const char* data, size_t size);
+void fat_rep_flush(fat_rep_t* rep);
+void fat_rep_free(fat_rep_t* rep);
+
+#endif /* __FATREP_H__ */
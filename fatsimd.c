@@ -0,0 +1,724 @@
+// fatsimd.c : fat simd kernels source file
+#include "fatsimd.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FAT_SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FAT_SIMD_TARGET(x)
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define FAT_SIMD_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+// decoded FAT values (see fat_fats_load), FAT12/16 are widened to FAT32 range
+#define FAT_CLUS_BAD        (0x0FFFFFF7)
+
+// crc32c (castagnoli) polynomial, bit reflected
+#define FAT_CRC32C_POLY     (0x82F63B78)
+// bytes of each of the three interleaved hardware crc streams
+#define FAT_CRC32C_LANE     (0x2000)
+
+typedef void (*fat_classify_fn)(const uint32_t* table, uint32_t start, uint32_t stop, fat_clus_stat_t* stat, uint8_t* free_map);
+typedef size_t (*fat_compare_fn)(const uint8_t* left, const uint8_t* right, size_t size);
+typedef uint64_t (*fat_popcount_fn)(const uint8_t* map, size_t size);
+typedef uint32_t (*fat_crc32c_fn)(uint32_t crc, const uint8_t* data, size_t size);
+typedef uint32_t (*fat_run_fn)(const uint32_t* table, uint32_t start, uint32_t stop);
+
+// slicing-by-8 tables, and the shifts by one and two lanes that merge the hardware streams.
+static uint32_t fat_crc_table[8][256];
+static uint32_t fat_crc_shift[2];
+static uint32_t fat_crc_fold[2];
+static volatile bool fat_crc_ready = false;
+
+static int fat_simd_detect(void)
+{
+#ifdef FAT_SIMD_X86
+    uint32_t regs[4] = { 0 };
+    uint64_t xcr0 = 0;
+    bool sse42 = false;
+    bool avx = false;
+#if defined(_MSC_VER)
+    __cpuid((int*)regs, 1);
+#else
+    __cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    sse42 = ((regs[2] >> 20) & 1) && ((regs[2] >> 23) & 1);
+    // avx needs osxsave and the os saving ymm state.
+    avx = ((regs[2] >> 27) & 1) && ((regs[2] >> 28) & 1);
+    if (avx)
+    {
+#if defined(_MSC_VER)
+        xcr0 = _xgetbv(0);
+#else
+        uint32_t eax = 0, edx = 0;
+        __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        xcr0 = ((uint64_t)edx << 32) | eax;
+#endif
+        avx = ((xcr0 & 0x06) == 0x06);
+    }
+    if (avx)
+    {
+#if defined(_MSC_VER)
+        __cpuidex((int*)regs, 7, 0);
+#else
+        __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        if ((regs[1] >> 5) & 1)
+        {
+            return FAT_SIMD_AVX2;
+        }
+    }
+    if (sse42)
+    {
+        return FAT_SIMD_SSE42;
+    }
+#endif
+    return FAT_SIMD_SCALAR;
+}
+
+#ifdef FAT_SIMD_X86
+static bool fat_simd_clmul(void)
+{
+    static int clmul = -1;
+    uint32_t regs[4] = { 0 };
+    if (clmul < 0)
+    {
+#if defined(_MSC_VER)
+        __cpuid((int*)regs, 1);
+#else
+        __cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        clmul = (int)((regs[2] >> 1) & 1);
+    }
+    return (clmul > 0);
+}
+#endif
+
+int fat_simd_level(void)
+{
+    static int level = -1;
+    if (level < 0)
+    {
+        level = fat_simd_detect();
+    }
+    return level;
+}
+
+const char* fat_simd_name(void)
+{
+    switch (fat_simd_level())
+    {
+    case FAT_SIMD_AVX2:
+        return "avx2";
+    case FAT_SIMD_SSE42:
+        return "sse4.2";
+    default:
+        return "scalar";
+    }
+}
+
+static void fat_classify_scalar(const uint32_t* table, uint32_t start, uint32_t stop, fat_clus_stat_t* stat, uint8_t* free_map)
+{
+    uint32_t index = 0;
+    uint32_t value = 0;
+    for (index = start; index < stop; index++)
+    {
+        value = table[index];
+        if (value == 0)
+        {
+            stat->free = stat->free + 1;
+            free_map[index >> 3] |= (uint8_t)(1 << (index & 7));
+        }
+        else if (value == 1)
+        {
+            stat->reserved = stat->reserved + 1;
+        }
+        else if (value < FAT_CLUS_BAD)
+        {
+            stat->used = stat->used + 1;
+        }
+        else if (value == FAT_CLUS_BAD)
+        {
+            stat->bad = stat->bad + 1;
+        }
+        else
+        {
+            stat->end = stat->end + 1;
+        }
+    }
+}
+
+static size_t fat_compare_scalar(const uint8_t* left, const uint8_t* right, size_t size)
+{
+    size_t index = 0;
+    uint64_t x = 0;
+    uint64_t y = 0;
+    // 8 bytes per step, then find the byte inside the word.
+    for (; index + 8 <= size; index = index + 8)
+    {
+        memcpy(&x, left + index, 8);
+        memcpy(&y, right + index, 8);
+        if (x != y)
+        {
+            break;
+        }
+    }
+    for (; index < size; index++)
+    {
+        if (left[index] != right[index])
+        {
+            break;
+        }
+    }
+    return index;
+}
+
+static uint64_t fat_popcount_scalar(const uint8_t* map, size_t size)
+{
+    size_t index = 0;
+    uint64_t x = 0;
+    uint64_t count = 0;
+    // swar bit count, 8 bytes per step.
+    for (; index + 8 <= size; index = index + 8)
+    {
+        memcpy(&x, map + index, 8);
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        count = count + ((x * 0x0101010101010101ULL) >> 56);
+    }
+    for (; index < size; index++)
+    {
+        for (x = map[index]; x != 0; x = x & (x - 1))
+        {
+            count = count + 1;
+        }
+    }
+    return count;
+}
+
+static uint32_t fat_run_scalar(const uint32_t* table, uint32_t start, uint32_t stop)
+{
+    uint32_t index = start;
+    // a cluster linked to the one right after it continues the extent.
+    while ((index + 1 < stop) && (table[index] == index + 1))
+    {
+        index = index + 1;
+    }
+    return index - start + 1;
+}
+
+#ifdef FAT_SIMD_X86
+FAT_SIMD_TARGET("popcnt")
+static uint64_t fat_popcount_hw(const uint8_t* map, size_t size)
+{
+    size_t index = 0;
+    uint32_t x = 0;
+    uint64_t count = 0;
+#if defined(_M_X64) || defined(__x86_64__)
+    uint64_t y = 0;
+    // four independent counters hide the popcnt latency.
+    uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    for (; index + 32 <= size; index = index + 32)
+    {
+        memcpy(&y, map + index, 8);
+        c0 = c0 + (uint64_t)_mm_popcnt_u64(y);
+        memcpy(&y, map + index + 8, 8);
+        c1 = c1 + (uint64_t)_mm_popcnt_u64(y);
+        memcpy(&y, map + index + 16, 8);
+        c2 = c2 + (uint64_t)_mm_popcnt_u64(y);
+        memcpy(&y, map + index + 24, 8);
+        c3 = c3 + (uint64_t)_mm_popcnt_u64(y);
+    }
+    count = c0 + c1 + c2 + c3;
+#endif
+    for (; index + 4 <= size; index = index + 4)
+    {
+        memcpy(&x, map + index, 4);
+        count = count + (uint64_t)_mm_popcnt_u32(x);
+    }
+    return count + fat_popcount_scalar(map + index, size - index);
+}
+
+static uint32_t fat_simd_ctz(uint32_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, bits);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(bits);
+#endif
+}
+
+FAT_SIMD_TARGET("sse4.2")
+static size_t fat_compare_sse42(const uint8_t* left, const uint8_t* right, size_t size)
+{
+    size_t index = 0;
+    uint32_t bits = 0;
+    __m128i v0, v1;
+    // 16 bytes per step, a clear mask bit is a differing byte.
+    for (; index + 16 <= size; index = index + 16)
+    {
+        v0 = _mm_loadu_si128((const __m128i*)(left + index));
+        v1 = _mm_loadu_si128((const __m128i*)(right + index));
+        bits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v0, v1)) ^ 0xFFFF;
+        if (bits != 0)
+        {
+            return index + fat_simd_ctz(bits);
+        }
+    }
+    return index + fat_compare_scalar(left + index, right + index, size - index);
+}
+
+FAT_SIMD_TARGET("avx2")
+static size_t fat_compare_avx2(const uint8_t* left, const uint8_t* right, size_t size)
+{
+    size_t index = 0;
+    uint32_t bits = 0;
+    __m256i v0, v1, v2, v3;
+    // 64 bytes per step, the mask is only decoded on a mismatch.
+    for (; index + 64 <= size; index = index + 64)
+    {
+        v0 = _mm256_loadu_si256((const __m256i*)(left + index));
+        v1 = _mm256_loadu_si256((const __m256i*)(right + index));
+        v2 = _mm256_loadu_si256((const __m256i*)(left + index + 32));
+        v3 = _mm256_loadu_si256((const __m256i*)(right + index + 32));
+        v0 = _mm256_cmpeq_epi8(v0, v1);
+        v2 = _mm256_cmpeq_epi8(v2, v3);
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_and_si256(v0, v2)) != 0xFFFFFFFF)
+        {
+            bits = ~(uint32_t)_mm256_movemask_epi8(v0);
+            if (bits != 0)
+            {
+                return index + fat_simd_ctz(bits);
+            }
+            return index + 32 + fat_simd_ctz(~(uint32_t)_mm256_movemask_epi8(v2));
+        }
+    }
+    return index + fat_compare_sse42(left + index, right + index, size - index);
+}
+
+FAT_SIMD_TARGET("sse4.2")
+static uint32_t fat_run_sse42(const uint32_t* table, uint32_t start, uint32_t stop)
+{
+    uint32_t index = start;
+    uint32_t bits = 0;
+    __m128i next = _mm_add_epi32(_mm_set1_epi32((int)start), _mm_setr_epi32(1, 2, 3, 4));
+    const __m128i step = _mm_set1_epi32(4);
+    // 4 entries per step, each must hold its own index plus one.
+    for (; index + 4 < stop; index = index + 4)
+    {
+        bits = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(table + index)), next))) ^ 0x0F;
+        if (bits != 0)
+        {
+            return index + fat_simd_ctz(bits) - start + 1;
+        }
+        next = _mm_add_epi32(next, step);
+    }
+    return index - start + fat_run_scalar(table, index, stop);
+}
+
+FAT_SIMD_TARGET("avx2")
+static uint32_t fat_run_avx2(const uint32_t* table, uint32_t start, uint32_t stop)
+{
+    uint32_t index = start;
+    uint32_t bits = 0;
+    __m256i next = _mm256_add_epi32(_mm256_set1_epi32((int)start), _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 8));
+    const __m256i step = _mm256_set1_epi32(8);
+    // 8 entries per step, a contiguous file is scanned at memory speed.
+    for (; index + 8 < stop; index = index + 8)
+    {
+        bits = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(table + index)), next))) ^ 0xFF;
+        if (bits != 0)
+        {
+            return index + fat_simd_ctz(bits) - start + 1;
+        }
+        next = _mm256_add_epi32(next, step);
+    }
+    return index - start + fat_run_sse42(table, index, stop);
+}
+
+FAT_SIMD_TARGET("sse4.2")
+static uint32_t fat_crc32c_tail(uint32_t crc, const uint8_t* data, size_t size)
+{
+    size_t index = 0;
+    uint32_t word = 0;
+#if defined(_M_X64) || defined(__x86_64__)
+    uint64_t value = crc;
+    uint64_t quad = 0;
+    for (; index + 8 <= size; index = index + 8)
+    {
+        memcpy(&quad, data + index, 8);
+        value = _mm_crc32_u64(value, quad);
+    }
+    crc = (uint32_t)value;
+#endif
+    for (; index + 4 <= size; index = index + 4)
+    {
+        memcpy(&word, data + index, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; index < size; index++)
+    {
+        crc = _mm_crc32_u8(crc, data[index]);
+    }
+    return crc;
+}
+
+#if defined(_M_X64) || defined(__x86_64__)
+FAT_SIMD_TARGET("sse4.2")
+static void fat_crc32c_block(uint32_t lane[3], const uint8_t* data)
+{
+    size_t index = 0;
+    uint64_t c0 = lane[0], c1 = lane[1], c2 = lane[2];
+    uint64_t w0 = 0, w1 = 0, w2 = 0;
+    // three independent streams hide the crc32 instruction latency.
+    for (index = 0; index < FAT_CRC32C_LANE; index = index + 8)
+    {
+        memcpy(&w0, data + index, 8);
+        memcpy(&w1, data + FAT_CRC32C_LANE + index, 8);
+        memcpy(&w2, data + FAT_CRC32C_LANE * 2 + index, 8);
+        c0 = _mm_crc32_u64(c0, w0);
+        c1 = _mm_crc32_u64(c1, w1);
+        c2 = _mm_crc32_u64(c2, w2);
+    }
+    lane[0] = (uint32_t)c0;
+    lane[1] = (uint32_t)c1;
+    lane[2] = (uint32_t)c2;
+}
+
+FAT_SIMD_TARGET("sse4.2,pclmul")
+static uint32_t fat_crc32c_fold(uint32_t crc, uint32_t fold)
+{
+    // the carry-less product is one bit short, crc32 of it divides by x^32.
+    __m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)crc), _mm_cvtsi32_si128((int)fold), 0);
+    return (uint32_t)_mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(product));
+}
+
+static uint32_t fat_crc_multiply(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+    uint32_t mask = 0x80000000;
+    // a * b mod p, bit 31 is x^0 in the reflected order.
+    for (; mask != 0; mask = mask >> 1)
+    {
+        if (a & mask)
+        {
+            product = product ^ b;
+        }
+        b = (b & 1) ? ((b >> 1) ^ FAT_CRC32C_POLY) : (b >> 1);
+    }
+    return product;
+}
+#endif
+
+FAT_SIMD_TARGET("sse4.2")
+static uint32_t fat_crc32c_sse42(uint32_t crc, const uint8_t* data, size_t size)
+{
+    size_t index = 0;
+#if defined(_M_X64) || defined(__x86_64__)
+    uint32_t lane[3] = { 0 };
+    for (; index + FAT_CRC32C_LANE * 3 <= size; index = index + FAT_CRC32C_LANE * 3)
+    {
+        lane[0] = crc;
+        lane[1] = 0;
+        lane[2] = 0;
+        fat_crc32c_block(lane, data + index);
+        crc = fat_crc_multiply(lane[0], fat_crc_shift[1]) ^ fat_crc_multiply(lane[1], fat_crc_shift[0]) ^ lane[2];
+    }
+#endif
+    return fat_crc32c_tail(crc, data + index, size - index);
+}
+
+FAT_SIMD_TARGET("sse4.2,pclmul")
+static uint32_t fat_crc32c_clmul(uint32_t crc, const uint8_t* data, size_t size)
+{
+    size_t index = 0;
+#if defined(_M_X64) || defined(__x86_64__)
+    uint32_t lane[3] = { 0 };
+    for (; index + FAT_CRC32C_LANE * 3 <= size; index = index + FAT_CRC32C_LANE * 3)
+    {
+        lane[0] = crc;
+        lane[1] = 0;
+        lane[2] = 0;
+        fat_crc32c_block(lane, data + index);
+        crc = fat_crc32c_fold(lane[0], fat_crc_fold[1]) ^ fat_crc32c_fold(lane[1], fat_crc_fold[0]) ^ lane[2];
+    }
+#endif
+    return fat_crc32c_tail(crc, data + index, size - index);
+}
+
+FAT_SIMD_TARGET("sse4.2,popcnt")
+static void fat_classify_sse42(const uint32_t* table, uint32_t start, uint32_t stop, fat_clus_stat_t* stat, uint8_t* free_map)
+{
+    uint32_t index = start;
+    uint32_t first = 0;
+    uint32_t bits = 0;
+    uint32_t free = 0;
+    uint32_t sums[4] = { 0 };
+    uint32_t lane = 0;
+    __m128i zero = _mm_setzero_si128();
+    __m128i one = _mm_set1_epi32(1);
+    __m128i bad = _mm_set1_epi32(FAT_CLUS_BAD);
+    __m128i rvd = zero, bds = zero, end = zero;
+    __m128i v0, v1;
+
+    // scalar head until the bitmap is byte aligned.
+    for (; (index < stop) && (index & 7); index++)
+    {
+        fat_classify_scalar(table, index, index + 1, stat, free_map);
+    }
+    first = index;
+    // 8 entries per step, one bitmap byte per step.
+    for (; index + 8 <= stop; index = index + 8)
+    {
+        v0 = _mm_loadu_si128((const __m128i*)&table[index]);
+        v1 = _mm_loadu_si128((const __m128i*)&table[index + 4]);
+        bits = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v0, zero)));
+        bits |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v1, zero))) << 4;
+        free_map[index >> 3] = (uint8_t)bits;
+        free = free + (uint32_t)_mm_popcnt_u32(bits);
+        rvd = _mm_sub_epi32(rvd, _mm_add_epi32(_mm_cmpeq_epi32(v0, one), _mm_cmpeq_epi32(v1, one)));
+        bds = _mm_sub_epi32(bds, _mm_add_epi32(_mm_cmpeq_epi32(v0, bad), _mm_cmpeq_epi32(v1, bad)));
+        end = _mm_sub_epi32(end, _mm_add_epi32(_mm_cmpgt_epi32(v0, bad), _mm_cmpgt_epi32(v1, bad)));
+    }
+    stat->free = stat->free + free;
+    stat->used = stat->used + (index - first) - free;
+    _mm_storeu_si128((__m128i*)sums, rvd);
+    for (lane = 0; lane < 4; lane++)
+    {
+        stat->reserved = stat->reserved + sums[lane];
+        stat->used = stat->used - sums[lane];
+    }
+    _mm_storeu_si128((__m128i*)sums, bds);
+    for (lane = 0; lane < 4; lane++)
+    {
+        stat->bad = stat->bad + sums[lane];
+        stat->used = stat->used - sums[lane];
+    }
+    _mm_storeu_si128((__m128i*)sums, end);
+    for (lane = 0; lane < 4; lane++)
+    {
+        stat->end = stat->end + sums[lane];
+        stat->used = stat->used - sums[lane];
+    }
+    fat_classify_scalar(table, index, stop, stat, free_map);
+}
+
+FAT_SIMD_TARGET("avx2,popcnt")
+static void fat_classify_avx2(const uint32_t* table, uint32_t start, uint32_t stop, fat_clus_stat_t* stat, uint8_t* free_map)
+{
+    uint32_t index = start;
+    uint32_t first = 0;
+    uint32_t bits = 0;
+    uint32_t free = 0;
+    uint32_t sums[8] = { 0 };
+    uint32_t lane = 0;
+    __m256i zero = _mm256_setzero_si256();
+    __m256i one = _mm256_set1_epi32(1);
+    __m256i bad = _mm256_set1_epi32(FAT_CLUS_BAD);
+    __m256i rvd = zero, bds = zero, end = zero;
+    __m256i v0;
+
+    // scalar head until the bitmap is byte aligned.
+    for (; (index < stop) && (index & 7); index++)
+    {
+        fat_classify_scalar(table, index, index + 1, stat, free_map);
+    }
+    first = index;
+    // 8 entries per step, one bitmap byte per step.
+    for (; index + 8 <= stop; index = index + 8)
+    {
+        v0 = _mm256_loadu_si256((const __m256i*)&table[index]);
+        bits = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v0, zero)));
+        free_map[index >> 3] = (uint8_t)bits;
+        free = free + (uint32_t)_mm_popcnt_u32(bits);
+        rvd = _mm256_sub_epi32(rvd, _mm256_cmpeq_epi32(v0, one));
+        bds = _mm256_sub_epi32(bds, _mm256_cmpeq_epi32(v0, bad));
+        end = _mm256_sub_epi32(end, _mm256_cmpgt_epi32(v0, bad));
+    }
+    stat->free = stat->free + free;
+    stat->used = stat->used + (index - first) - free;
+    _mm256_storeu_si256((__m256i*)sums, rvd);
+    for (lane = 0; lane < 8; lane++)
+    {
+        stat->reserved = stat->reserved + sums[lane];
+        stat->used = stat->used - sums[lane];
+    }
+    _mm256_storeu_si256((__m256i*)sums, bds);
+    for (lane = 0; lane < 8; lane++)
+    {
+        stat->bad = stat->bad + sums[lane];
+        stat->used = stat->used - sums[lane];
+    }
+    _mm256_storeu_si256((__m256i*)sums, end);
+    for (lane = 0; lane < 8; lane++)
+    {
+        stat->end = stat->end + sums[lane];
+        stat->used = stat->used - sums[lane];
+    }
+    fat_classify_scalar(table, index, stop, stat, free_map);
+}
+#endif
+
+void fat_simd_classify(const uint32_t* table, uint32_t start, uint32_t stop, fat_clus_stat_t* stat, uint8_t* free_map)
+{
+    fat_classify_fn classify = fat_classify_scalar;
+#ifdef FAT_SIMD_X86
+    switch (fat_simd_level())
+    {
+    case FAT_SIMD_AVX2:
+        classify = fat_classify_avx2;
+        break;
+    case FAT_SIMD_SSE42:
+        classify = fat_classify_sse42;
+        break;
+    default:
+        break;
+    }
+#endif
+    classify(table, start, stop, stat, free_map);
+}
+
+size_t fat_simd_compare(const uint8_t* left, const uint8_t* right, size_t size)
+{
+    fat_compare_fn compare = fat_compare_scalar;
+#ifdef FAT_SIMD_X86
+    switch (fat_simd_level())
+    {
+    case FAT_SIMD_AVX2:
+        compare = fat_compare_avx2;
+        break;
+    case FAT_SIMD_SSE42:
+        compare = fat_compare_sse42;
+        break;
+    default:
+        break;
+    }
+#endif
+    return compare(left, right, size);
+}
+
+static uint32_t fat_crc32c_scalar(uint32_t crc, const uint8_t* data, size_t size)
+{
+    size_t index = 0;
+    // 8 bytes per step through the sliced tables.
+    for (; index + 8 <= size; index = index + 8)
+    {
+        crc = crc ^ ((uint32_t)data[index] | ((uint32_t)data[index + 1] << 8) | ((uint32_t)data[index + 2] << 16) | ((uint32_t)data[index + 3] << 24));
+        crc = fat_crc_table[7][crc & 0xFF] ^ fat_crc_table[6][(crc >> 8) & 0xFF] ^
+            fat_crc_table[5][(crc >> 16) & 0xFF] ^ fat_crc_table[4][crc >> 24] ^
+            fat_crc_table[3][data[index + 4]] ^ fat_crc_table[2][data[index + 5]] ^
+            fat_crc_table[1][data[index + 6]] ^ fat_crc_table[0][data[index + 7]];
+    }
+    for (; index < size; index++)
+    {
+        crc = (crc >> 8) ^ fat_crc_table[0][(crc ^ data[index]) & 0xFF];
+    }
+    return crc;
+}
+
+static uint32_t fat_crc_xpow(uint64_t bits)
+{
+    uint32_t value = 0x80000000;
+    // x^bits mod p, one multiply by x per bit.
+    for (; bits > 0; bits--)
+    {
+        value = (value & 1) ? ((value >> 1) ^ FAT_CRC32C_POLY) : (value >> 1);
+    }
+    return value;
+}
+
+static void fat_crc_init(void)
+{
+    uint32_t index = 0;
+    uint32_t bit = 0;
+    uint32_t value = 0;
+    if (fat_crc_ready)
+    {
+        return;
+    }
+    for (index = 0; index < 256; index++)
+    {
+        value = index;
+        for (bit = 0; bit < 8; bit++)
+        {
+            value = (value & 1) ? ((value >> 1) ^ FAT_CRC32C_POLY) : (value >> 1);
+        }
+        fat_crc_table[0][index] = value;
+    }
+    for (index = 0; index < 256; index++)
+    {
+        for (bit = 1; bit < 8; bit++)
+        {
+            value = fat_crc_table[bit - 1][index];
+            fat_crc_table[bit][index] = (value >> 8) ^ fat_crc_table[0][value & 0xFF];
+        }
+    }
+    // a stream is moved past the lanes behind it by x^(8 * bytes), clmul needs it over x^33.
+    fat_crc_shift[0] = fat_crc_xpow((uint64_t)FAT_CRC32C_LANE * 8);
+    fat_crc_shift[1] = fat_crc_xpow((uint64_t)FAT_CRC32C_LANE * 16);
+    fat_crc_fold[0] = fat_crc_xpow((uint64_t)FAT_CRC32C_LANE * 8 - 33);
+    fat_crc_fold[1] = fat_crc_xpow((uint64_t)FAT_CRC32C_LANE * 16 - 33);
+    fat_crc_ready = true;
+}
+
+uint32_t fat_simd_crc32c(uint32_t crc, const void* data, size_t size)
+{
+    fat_crc32c_fn crc32c = fat_crc32c_scalar;
+    fat_crc_init();
+#ifdef FAT_SIMD_X86
+    if (fat_simd_level() != FAT_SIMD_SCALAR)
+    {
+        crc32c = fat_simd_clmul() ? fat_crc32c_clmul : fat_crc32c_sse42;
+    }
+#endif
+    return ~crc32c(~crc, (const uint8_t*)data, size);
+}
+
+uint32_t fat_simd_run(const uint32_t* table, uint32_t start, uint32_t stop)
+{
+    fat_run_fn run = fat_run_scalar;
+#ifdef FAT_SIMD_X86
+    switch (fat_simd_level())
+    {
+    case FAT_SIMD_AVX2:
+        run = fat_run_avx2;
+        break;
+    case FAT_SIMD_SSE42:
+        run = fat_run_sse42;
+        break;
+    default:
+        break;
+    }
+#endif
+    return run(table, start, stop);
+}
+
+const char* fat_simd_crc_name(void)
+{
+#ifdef FAT_SIMD_X86
+    if (fat_simd_level() != FAT_SIMD_SCALAR)
+    {
+        return fat_simd_clmul() ? "sse4.2+pclmul" : "sse4.2";
+    }
+#endif
+    return "scalar";
+}
+
+uint64_t fat_simd_popcount(const uint8_t* map, size_t size)
+{
+    fat_popcount_fn popcount = fat_popcount_scalar;
+#ifdef FAT_SIMD_X86
+    // sse4.2 capable cpus all have popcnt.
+    if (fat_simd_level() != FAT_SIMD_SCALAR)
+    {
+        popcount = fat_popcount_hw;
+    }
+#endif
+    return popcount(map, size);
+}
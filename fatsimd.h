@@ -0,0 +1,35 @@
+// fatsimd.h : fat simd kernels header file
+#ifndef __FATSIMD_H__
+#define __FATSIMD_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// simd level selected at runtime
+#define FAT_SIMD_SCALAR     (0)
+#define FAT_SIMD_SSE42      (1)
+#define FAT_SIMD_AVX2       (2)
+
+typedef struct fat_clus_stat
+{
+    uint32_t free;
+    uint32_t reserved;
+    uint32_t used;
+    uint32_t bad;
+    uint32_t end;
+} fat_clus_stat_t;
+
+int fat_simd_level(void);
+const char* fat_simd_name(void);
+void fat_simd_classify(const uint32_t* table, uint32_t start, uint32_t stop, fat_clus_stat_t* stat, uint8_t* free_map);
+size_t fat_simd_compare(const uint8_t* left, const uint8_t* right, size_t size);
+uint64_t fat_simd_popcount(const uint8_t* map, size_t size);
+// clusters from start linked one after another, at least 1, never past stop.
+uint32_t fat_simd_run(const uint32_t* table, uint32_t start, uint32_t stop);
+// crc32c of data continuing crc, start with 0.
+uint32_t fat_simd_crc32c(uint32_t crc, const void* data, size_t size);
+const char* fat_simd_crc_name(void);
+
+#endif /* __FATSIMD_H__ */
@@ -0,0 +1,203 @@
+# fatck benchmark runner, times every check phase over a matrix of generated images.
+import os
+import sys
+import csv
+import json
+import time
+import argparse
+import statistics
+import subprocess
+import xml.sax
+import traceback
+from logs import logger
+
+software_version = "v0.1.0"
+
+# phases of the checker stats record, total is measured around the process
+PHASES = ["bpb_us", "fat_load_us", "fat_check_us", "dirs_us", "lost_us", "chains_us", "total_us"]
+# counters of the stats record, written to the csv but never compared
+COUNTERS = ["bytes_read", "read_calls", "cache_hits", "cache_misses", "fat_entries", "dir_entries", "clusters_visited",
+            "chain_extents", "chains_fragmented"]
+# image parameters, the generator option of each and its default
+PARAMS = [("type", "-t", "16"), ("sector", "-s", "512"), ("cluster", "-c", "4"), ("files", "-n", "1000"),
+          ("depth", "-d", "3"), ("width", "-w", "4"), ("max_size", "-m", "16384"), ("lfn", "--lfn", "0.5"),
+          ("fragment", "--fragment", "0.0"), ("corrupt", "--corrupt", ""), ("seed", "--seed", "1")]
+# phases shorter than this are noise and never flagged
+NOISE_US = 1000
+
+
+class BenchImage:
+    def __init__(self, name, params, check):
+        self.name = name
+        self.params = params
+        self.check = check
+
+
+class XmlHandler(xml.sax.ContentHandler):
+    def __init__(self):
+        self.current = ""
+        self.name = ""
+        self.params = {}
+        self.check = ""
+        self.list = []
+
+    def startElement(self, tag, attributes):
+        self.current = tag
+        if tag == "image":
+            self.name = attributes["name"]
+            self.params = {}
+            self.check = ""
+
+    def endElement(self, tag):
+        if tag == "image":
+            self.list.append(BenchImage(self.name, self.params, self.check))
+            self.name = ""
+            self.params = {}
+            self.check = ""
+        self.current = ""
+
+    def characters(self, content):
+        if self.name and self.current in [it[0] for it in PARAMS]:
+            self.params[self.current] = self.params.get(self.current, "") + content.strip()
+        # extra checker options of the image, e.g. the read backend instead of the mapped one
+        if self.name and self.current == "check":
+            self.check = self.check + content.strip()
+
+    def result(self):
+        return self.list
+
+
+def ParseConfigFile(path):
+    handle = XmlHandler()
+    parser = xml.sax.make_parser()
+    parser.setFeature(xml.sax.handler.feature_namespaces, 0)
+    parser.setContentHandler(handle)
+    parser.parse(path)
+    return handle.result()
+
+
+def BuildImage(image, work_dir, force):
+    path = os.path.join(work_dir, image.name + ".img")
+    if os.path.exists(path) and not force:
+        return path
+    generator = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "fat_image", "main.py")
+    command = [sys.executable, generator, "-o", path, "-l", "30"]
+    for key, option, default in PARAMS:
+        value = image.params.get(key, default)
+        if value:
+            command = command + [option, value]
+    logger.info("image build = {}".format(" ".join(command)))
+    subprocess.run(command, check=True)
+    return path
+
+
+def RunCheck(binary, image, path, threads):
+    sector = image.params.get("sector", "512")
+    command = [binary, "-b", sector, "--stats", "-j", "-v", "0", "-t", str(threads)] + image.check.split() + [path]
+    start = time.perf_counter()
+    process = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    total = int((time.perf_counter() - start) * 1000000)
+    stats = None
+    # the report is json lines, anything else printed by the binary is skipped
+    for line in process.stdout.decode("utf-8", "replace").splitlines():
+        if not line.startswith("{"):
+            continue
+        record = json.loads(line)
+        if record.get("type") == "stats":
+            stats = record
+    if stats is None:
+        raise Exception("image {} has no stats record, is {} a fatck build with --stats?".format(image.name, binary))
+    stats["total_us"] = total
+    stats["result"] = process.returncode
+    return stats
+
+
+def LoadBaseline(path):
+    runs = {}
+    with open(path, newline="") as baseline:
+        for row in csv.DictReader(baseline):
+            runs.setdefault(row["image"], []).append(row)
+    return {name: {phase: statistics.median(int(it[phase]) for it in rows) for phase in PHASES}
+            for name, rows in runs.items()}
+
+
+def CheckBaseline(baseline, current, tolerance):
+    regressions = 0
+    for name, phases in current.items():
+        if name not in baseline:
+            logger.warning("baseline has no image {}, not compared.".format(name))
+            continue
+        for phase in PHASES:
+            before = baseline[name][phase]
+            after = phases[phase]
+            if (after > before * (1 + tolerance)) and (after - before > NOISE_US):
+                logger.error("regression {} {} : {}us -> {}us".format(name, phase, int(before), int(after)))
+                regressions = regressions + 1
+    return regressions
+
+
+def BenchProcess(args):
+    images = ParseConfigFile(args.config)
+    if os.path.exists(args.work) is False:
+        os.makedirs(args.work)
+    current = {}
+    with open(args.output, "w", newline="") as output:
+        writer = csv.writer(output)
+        writer.writerow(["image"] + [it[0] for it in PARAMS] + ["check", "threads", "run", "result"] + PHASES + COUNTERS)
+        for image in images:
+            path = BuildImage(image, args.work, args.force)
+            runs = []
+            # the first run warms the page cache and is not recorded
+            RunCheck(args.binary, image, path, args.threads)
+            for run in range(args.repeat):
+                stats = RunCheck(args.binary, image, path, args.threads)
+                writer.writerow([image.name] + [image.params.get(key, default) for key, option, default in PARAMS] +
+                                [image.check, args.threads, run, stats["result"]] + [stats[phase] for phase in PHASES] +
+                                [stats[counter] for counter in COUNTERS])
+                runs.append(stats)
+            current[image.name] = {phase: statistics.median(it[phase] for it in runs) for phase in PHASES}
+            logger.info("{} : {}".format(image.name, ", ".join("{} {}".format(phase, int(current[image.name][phase]))
+                                                                 for phase in PHASES)))
+    if args.baseline is None:
+        return 0
+    return CheckBaseline(LoadBaseline(args.baseline), current, args.tolerance)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='fatck benchmark tools')
+
+    parser.add_argument('-b', '--binary', help='fatck binary path.', dest="binary", required=True)
+    parser.add_argument('-c', '--config', help='Benchmark matrix config file path.', dest="config",
+                        default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "config.xml"))
+    parser.add_argument('-o', '--output', help='Output csv path.', dest="output", default="bench.csv")
+    parser.add_argument('-w', '--work', help='Directory of the generated images.', dest="work", default="images")
+    parser.add_argument('-f', '--force', help='Rebuild images that already exist.', dest="force", action="store_true")
+    parser.add_argument('-r', '--repeat', help='Timed runs per image.', dest="repeat", type=int, default=5)
+    parser.add_argument('-t', '--threads', help='Checker threads, 0 uses one per cpu.', dest="threads", type=int, default=0)
+    parser.add_argument('-g', '--baseline', help='Baseline csv, slower medians fail the run.', dest="baseline")
+    parser.add_argument('--tolerance', help='Allowed slowdown against the baseline, 0.2 is 20%%.', dest="tolerance",
+                        type=float, default=0.2)
+    parser.add_argument("-v", "--version", help="Show the current version.", action="version", version=software_version)
+    parser.add_argument("-l", "--log", help="Log level:10-debug,20-info,30-warning,40-error,50-critical.", dest="log",
+                        default=20, required=False)
+
+    args = parser.parse_args()
+    logger.set_level(int(args.log))
+    args.binary = os.path.abspath(args.binary)
+    args.config = os.path.abspath(args.config)
+    args.output = os.path.abspath(args.output)
+    args.work = os.path.abspath(args.work)
+    try:
+        regressions = BenchProcess(args)
+    except Exception as ex:
+        logger.error(ex.__str__())
+        logger.error(traceback.format_exc())
+        return 1
+    if regressions > 0:
+        logger.error("{} phase timings regressed against {}.".format(regressions, args.baseline))
+        return 2
+    return 0
+
+
+if __name__ == '__main__':
+    exit(main())
@@ -0,0 +1,416 @@
+# FAT image generator, builds FAT12/16/32 test images for fatck.
+import os
+import array
+import random
+import struct
+import argparse
+import traceback
+from logs import logger
+
+software_version = "v0.1.0"
+
+# data cluster count of every FAT type, the count decides the type
+CLUSTER_RANGE = {12: (16, 4084), 16: (4085, 65524), 32: (65525, 0x0FFFFFF5)}
+CLUSTER_EOC = {12: 0x00000FFF, 16: 0x0000FFFF, 32: 0x0FFFFFFF}
+CLUSTER_MEDIA = 0xF8
+# free clusters left on top of the content
+CLUSTER_SLACK = 0.25
+CORRUPT_KINDS = ["cross", "loop", "lost", "broken", "mirror", "mirror_odd", "fsinfo"]
+
+ATTR_DIRECTORY = 0x10
+ATTR_ARCHIVE = 0x20
+ATTR_LONG_NAME = 0x0F
+LFN_LAST = 0x40
+LFN_CHARS = 13
+# 2024-01-01 12:00:00
+DIR_DATE = ((2024 - 1980) << 9) | (1 << 5) | 1
+DIR_TIME = 12 << 11
+
+
+class Node:
+    def __init__(self, name, short, directory, size):
+        # long name, None when the short name is enough
+        self.name = name
+        self.short = short
+        self.directory = directory
+        self.size = size
+        self.children = []
+        self.chain = []
+
+    def entry_count(self):
+        if self.name is None:
+            return 1
+        return 1 + (len(self.name.encode("utf-16-le")) // 2 + LFN_CHARS) // LFN_CHARS
+
+    def dir_size(self, root):
+        # dot entries, then every child with its long name entries
+        count = 0 if root else 2
+        for child in self.children:
+            count = count + child.entry_count()
+        return count * 32
+
+
+def ShortName(base, ext):
+    return base.ljust(8).encode("ascii") + ext.ljust(3).encode("ascii")
+
+
+def NewNode(rnd, parent, directory, size, lfn_ratio):
+    index = len(parent.children) + 1
+    tail = "~%d" % index
+    if rnd.random() < lfn_ratio:
+        # some long names leave the ascii range
+        accent = "é" if (index % 4) == 0 else ""
+        if directory:
+            node = Node("Directory %d%s" % (index, accent), ShortName("DIRECT"[:8 - len(tail)] + tail, ""), True, 0)
+        else:
+            node = Node("Long file name %d%s.bin" % (index, accent), ShortName("LONGFI"[:8 - len(tail)] + tail, "BIN"), False, size)
+    elif directory:
+        node = Node(None, ShortName("D%07d" % index, ""), True, 0)
+    else:
+        node = Node(None, ShortName("F%07d" % index, "BIN"), False, size)
+    parent.children.append(node)
+    return node
+
+
+def BuildTree(rnd, files, depth, width, lfn_ratio, max_size):
+    root = Node(None, None, True, 0)
+    dirs = [root]
+    level = [root]
+    for _ in range(depth):
+        next_level = []
+        for parent in level:
+            for _ in range(width):
+                next_level.append(NewNode(rnd, parent, True, 0, lfn_ratio))
+        dirs = dirs + next_level
+        level = next_level
+    # files land in random directories of the tree
+    for _ in range(files):
+        NewNode(rnd, rnd.choice(dirs), False, rnd.randint(0, max_size), lfn_ratio)
+    return root, dirs
+
+
+def LfnChecksum(short):
+    value = 0
+    for it in short:
+        value = (((value & 1) << 7) + (value >> 1) + it) & 0xFF
+    return value
+
+
+def DirEntry(short, attr, cluster, size):
+    return struct.pack("<11sBBBHHHHHHHI", short, attr, 0, 0, DIR_TIME, DIR_DATE, DIR_DATE,
+                       cluster >> 16, DIR_TIME, DIR_DATE, cluster & 0xFFFF, size)
+
+
+def NodeEntries(node):
+    out = []
+    cluster = node.chain[0] if node.chain else 0
+    if node.name is not None:
+        units = node.name.encode("utf-16-le") + b"\x00\x00"
+        units = units + b"\xff\xff" * ((LFN_CHARS - (len(units) // 2) % LFN_CHARS) % LFN_CHARS)
+        parts = len(units) // (LFN_CHARS * 2)
+        checksum = LfnChecksum(node.short)
+        # long name entries are stored last part first
+        for order in range(parts, 0, -1):
+            part = units[(order - 1) * LFN_CHARS * 2:order * LFN_CHARS * 2]
+            entry = bytearray(32)
+            entry[0] = order | (LFN_LAST if order == parts else 0)
+            entry[1:11] = part[0:10]
+            entry[11] = ATTR_LONG_NAME
+            entry[13] = checksum
+            entry[14:26] = part[10:22]
+            entry[28:32] = part[22:26]
+            out.append(bytes(entry))
+    out.append(DirEntry(node.short, ATTR_DIRECTORY if node.directory else ATTR_ARCHIVE, cluster, node.size))
+    return out
+
+
+class FatImage:
+    def __init__(self, fat_type, sector_size, cluster_sectors, clusters, root_entries, seed, fragment):
+        self.fat_type = fat_type
+        self.sector_size = sector_size
+        self.cluster_sectors = cluster_sectors
+        self.cluster_size = sector_size * cluster_sectors
+        self.clusters = clusters
+        self.fats = 2
+        self.reserved = 32 if fat_type == 32 else 1
+        self.root_entries = 0 if fat_type == 32 else root_entries
+        self.root_sectors = (self.root_entries * 32 + sector_size - 1) // sector_size
+        if fat_type == 12:
+            fat_bytes = ((clusters + 2) * 3 + 1) // 2
+        else:
+            fat_bytes = (clusters + 2) * fat_type // 8
+        self.fat_sectors = (fat_bytes + sector_size - 1) // sector_size
+        self.data_start = self.reserved + self.fats * self.fat_sectors + self.root_sectors
+        self.total = self.data_start + clusters * cluster_sectors
+        self.eoc = CLUSTER_EOC[fat_type]
+        self.table = array.array("I", [0]) * (clusters + 2)
+        self.table[0] = (self.eoc & ~0xFF) | CLUSTER_MEDIA
+        self.table[1] = self.eoc
+        self.free = clusters
+        self.cursor = 2
+        self.rnd = random.Random(seed)
+        self.fragment = fragment
+        self.file = None
+
+    def next_free(self):
+        if self.free == 0:
+            raise Exception("fat image is full.")
+        while self.table[self.cursor] != 0:
+            self.cursor = self.cursor + 1
+            if self.cursor >= self.clusters + 2:
+                self.cursor = 2
+        self.table[self.cursor] = self.eoc
+        self.free = self.free - 1
+        return self.cursor
+
+    def allocate(self, count):
+        chain = []
+        for index in range(count):
+            # a fragmented chain jumps to a random place of the volume
+            if (index > 0) and (self.fragment > 0) and (self.rnd.random() < self.fragment):
+                self.cursor = self.rnd.randrange(2, self.clusters + 2)
+            chain.append(self.next_free())
+        for current, following in zip(chain, chain[1:]):
+            self.table[current] = following
+        return chain
+
+    def cluster_offset(self, cluster):
+        return (self.data_start + (cluster - 2) * self.cluster_sectors) * self.sector_size
+
+    def write(self, offset, data):
+        self.file.seek(offset)
+        self.file.write(data)
+
+    def write_chain(self, chain, data):
+        start = 0
+        # contiguous runs go out as one write
+        while start < len(chain):
+            end = start + 1
+            while (end < len(chain)) and (chain[end] == chain[end - 1] + 1):
+                end = end + 1
+            chunk = data[start * self.cluster_size:end * self.cluster_size]
+            if len(chunk) > 0:
+                self.write(self.cluster_offset(chain[start]), chunk)
+            start = end
+
+    def fat_bytes(self):
+        if self.fat_type == 16:
+            return array.array("H", self.table).tobytes()
+        if self.fat_type == 32:
+            return self.table.tobytes()
+        out = bytearray(((len(self.table) * 3) + 1) // 2)
+        for index, value in enumerate(self.table):
+            offset = index * 3 // 2
+            if index & 1:
+                out[offset] = (out[offset] & 0x0F) | ((value << 4) & 0xF0)
+                out[offset + 1] = (value >> 4) & 0xFF
+            else:
+                out[offset] = value & 0xFF
+                out[offset + 1] = (out[offset + 1] & 0xF0) | ((value >> 8) & 0x0F)
+        return bytes(out)
+
+    def boot_sector(self, root_cluster):
+        boot = bytearray(self.sector_size)
+        boot[0:3] = b"\xEB\x58\x90" if self.fat_type == 32 else b"\xEB\x3C\x90"
+        boot[3:11] = b"MSWIN4.1"
+        small = (self.fat_type != 32) and (self.total < 0x10000)
+        struct.pack_into("<HBHBHHBHHHII", boot, 11, self.sector_size, self.cluster_sectors, self.reserved, self.fats,
+                         self.root_entries, self.total if small else 0, CLUSTER_MEDIA,
+                         0 if self.fat_type == 32 else self.fat_sectors, 63, 255, 0, 0 if small else self.total)
+        if self.fat_type == 32:
+            struct.pack_into("<IHHIHH", boot, 36, self.fat_sectors, 0, 0, root_cluster, 1, 6)
+            struct.pack_into("<BBBI11s8s", boot, 64, 0x80, 0, 0x29, 0x20240101, b"NO NAME    ", b"FAT32   ")
+        else:
+            struct.pack_into("<BBBI11s8s", boot, 36, 0x80, 0, 0x29, 0x20240101, b"NO NAME    ",
+                             b"FAT12   " if self.fat_type == 12 else b"FAT16   ")
+        boot[510:512] = b"\x55\xAA"
+        return bytes(boot)
+
+    def fsinfo_sector(self, free_count):
+        info = bytearray(self.sector_size)
+        struct.pack_into("<I", info, 0, 0x41615252)
+        struct.pack_into("<IIII", info, 484, 0x61417272, free_count, self.cursor, 0)
+        struct.pack_into("<I", info, 508, 0xAA550000)
+        return bytes(info)
+
+
+def ChainClusters(image, node, root):
+    size = node.dir_size(root) if node.directory else node.size
+    count = (size + image.cluster_size - 1) // image.cluster_size
+    return max(count, 1) if node.directory else count
+
+
+def AllocateTree(image, node):
+    # a directory is followed by its files, then its subdirectories
+    for child in node.children:
+        child.chain = image.allocate(ChainClusters(image, child, False))
+    for child in node.children:
+        if child.directory:
+            AllocateTree(image, child)
+
+
+def WriteTree(image, rnd, node, self_cluster, parent_cluster):
+    entries = []
+    if self_cluster != 0:
+        entries.append(DirEntry(ShortName(".", ""), ATTR_DIRECTORY, self_cluster, 0))
+        entries.append(DirEntry(ShortName("..", ""), ATTR_DIRECTORY, parent_cluster, 0))
+    for child in node.children:
+        entries = entries + NodeEntries(child)
+        if child.directory:
+            image.write_chain(child.chain, WriteTree(image, rnd, child, child.chain[0], self_cluster))
+        elif child.size > 0:
+            image.write_chain(child.chain, rnd.randbytes(child.size))
+    return b"".join(entries)
+
+
+def Corrupt(image, rnd, root, dirs, kinds):
+    files = [it for parent in dirs for it in parent.children if not it.directory and len(it.chain) > 0]
+    longer = [it for it in files if len(it.chain) > 1]
+    lost = 0
+    for kind in kinds:
+        if kind == "cross" and len(files) > 1 and len(longer) > 0:
+            owner = rnd.choice(longer)
+            other = rnd.choice([it for it in files if it is not owner])
+            target = owner.chain[len(owner.chain) // 2]
+            image.table[other.chain[-1]] = target
+            logger.info("corrupt cross : cluster {} now links to {}".format(other.chain[-1], target))
+        elif kind == "loop" and len(longer) > 0:
+            owner = rnd.choice(longer)
+            image.table[owner.chain[-1]] = owner.chain[0]
+            logger.info("corrupt loop : cluster {} now links to {}".format(owner.chain[-1], owner.chain[0]))
+        elif kind == "broken" and len(longer) > 0 and image.free > 0:
+            owner = rnd.choice(longer)
+            target = image.next_free()
+            # the picked cluster stays free
+            image.table[target] = 0
+            image.free = image.free + 1
+            image.table[owner.chain[0]] = target
+            logger.info("corrupt broken : cluster {} now links to free cluster {}".format(owner.chain[0], target))
+        elif kind == "lost" and image.free > 3:
+            chain = image.allocate(3)
+            lost = lost + 3
+            logger.info("corrupt lost : chain of 3 clusters at {}".format(chain[0]))
+        elif kind in ["mirror", "mirror_odd", "fsinfo"]:
+            # applied while the FAT copies and FSInfo are written
+            continue
+        else:
+            logger.warning("corrupt {} : not applicable to this image, skipped.".format(kind))
+    return lost
+
+
+def BuildImage(args):
+    rnd = random.Random(args.seed)
+    kinds = [it for it in args.corrupt.split(",") if it] if args.corrupt else []
+    for kind in kinds:
+        if kind not in CORRUPT_KINDS:
+            raise Exception("unknown corruption {}, expected one of {}.".format(kind, ",".join(CORRUPT_KINDS)))
+    root, dirs = BuildTree(rnd, args.files, args.depth, args.width, args.lfn, args.max_size)
+    cluster_size = args.sector_size * args.cluster_sectors
+    # size the volume from its content, then clamp into the range of the type
+    need = 3 * len(kinds)
+    root_entries = 0
+    for node in dirs:
+        size = node.dir_size(node is root)
+        if node is root and args.type != 32:
+            # the FAT12/16 root is a fixed region of whole sectors
+            per_sector = args.sector_size // 32
+            root_entries = max(512, (size // 32 + per_sector - 1) // per_sector * per_sector)
+        else:
+            need = need + max(1, (size + cluster_size - 1) // cluster_size)
+        for child in node.children:
+            if not child.directory:
+                need = need + (child.size + cluster_size - 1) // cluster_size
+    clusters = max(CLUSTER_RANGE[args.type][0], int(need * (1 + CLUSTER_SLACK)) + 16)
+    if clusters > CLUSTER_RANGE[args.type][1]:
+        raise Exception("content needs {} clusters, too many for FAT{}, use larger clusters.".format(clusters, args.type))
+    image = FatImage(args.type, args.sector_size, args.cluster_sectors, clusters, root_entries, args.seed, args.fragment)
+    root_cluster = 0
+    if args.type == 32:
+        root.chain = image.allocate(ChainClusters(image, root, True))
+        root_cluster = root.chain[0]
+    AllocateTree(image, root)
+    Corrupt(image, rnd, root, dirs, kinds)
+    if os.path.exists(args.output) is True:
+        os.remove(args.output)
+    image.file = open(args.output, "wb+")
+    image.file.truncate(image.total * image.sector_size)
+    rootdata = WriteTree(image, rnd, root, 0, 0)
+    if args.type == 32:
+        image.write_chain(root.chain, rootdata)
+    else:
+        image.write((image.reserved + image.fats * image.fat_sectors) * image.sector_size, rootdata)
+    fat = image.fat_bytes()
+    for index in range(image.fats):
+        copy = bytearray(fat)
+        if index > 0 and "mirror" in kinds:
+            offset = rnd.randrange(min(len(copy), 8), len(copy))
+            copy[offset] = copy[offset] ^ 0xFF
+            logger.info("corrupt mirror : FAT{} byte {} flipped".format(index + 1, offset))
+        if index > 0 and "mirror_odd" in kinds:
+            # high nibble of a byte, on FAT12 it belongs to the odd entry sharing the byte with an even one
+            entry = rnd.randrange(1, (image.clusters + 2) // 2) * 2 + 1
+            offset = entry * args.type // 8
+            copy[offset] = copy[offset] ^ 0xF0
+            logger.info("corrupt mirror_odd : FAT{} byte {} high nibble flipped".format(index + 1, offset))
+        image.write((image.reserved + index * image.fat_sectors) * image.sector_size, bytes(copy))
+    boot = image.boot_sector(root_cluster)
+    image.write(0, boot)
+    if args.type == 32:
+        free_count = image.free
+        if "fsinfo" in kinds:
+            free_count = free_count + 7
+            logger.info("corrupt fsinfo : free count {} instead of {}".format(free_count, image.free))
+        info = image.fsinfo_sector(free_count)
+        # backup boot sector and FSInfo at sector 6
+        image.write(image.sector_size, info)
+        image.write(6 * image.sector_size, boot)
+        image.write(7 * image.sector_size, info)
+    elif "fsinfo" in kinds:
+        logger.warning("corrupt fsinfo : not applicable to FAT{}, skipped.".format(args.type))
+    image.file.close()
+    # debug information
+    logger.info("====================================================")
+    logger.info("image output = {}".format(args.output))
+    logger.info("image type = FAT{}, clusters = {}, free = {}".format(args.type, clusters, image.free))
+    logger.info("image files = {}, directories = {}".format(args.files, len(dirs)))
+    logger.info("image length = {}".format(image.total * image.sector_size))
+    logger.info("====================================================")
+
+
+def main():
+    parser = argparse.ArgumentParser(description='FAT image generator')
+
+    parser.add_argument('-o', '--output', help='Output image path.', dest="output", required=True)
+    parser.add_argument('-t', '--type', help='FAT type: 12, 16 or 32.', dest="type", type=int, choices=[12, 16, 32], default=16)
+    parser.add_argument('-s', '--sector', help='Bytes per sector.', dest="sector_size", type=int,
+                        choices=[512, 1024, 2048, 4096], default=512)
+    parser.add_argument('-c', '--cluster', help='Sectors per cluster.', dest="cluster_sectors", type=int,
+                        choices=[1, 2, 4, 8, 16, 32, 64, 128], default=4)
+    parser.add_argument('-n', '--files', help='Number of files.', dest="files", type=int, default=1000)
+    parser.add_argument('-d', '--depth', help='Directory tree depth.', dest="depth", type=int, default=3)
+    parser.add_argument('-w', '--width', help='Subdirectories per directory.', dest="width", type=int, default=4)
+    parser.add_argument('-m', '--max-size', help='Largest file size in bytes.', dest="max_size", type=int, default=16384)
+    parser.add_argument('--lfn', help='Ratio of long file names, 0.0 to 1.0.', dest="lfn", type=float, default=0.5)
+    parser.add_argument('--fragment', help='Chance of a chain jump per cluster, 0.0 to 1.0.', dest="fragment",
+                        type=float, default=0.0)
+    parser.add_argument('--corrupt', help='Injected errors: {}.'.format(",".join(CORRUPT_KINDS)), dest="corrupt",
+                        default="")
+    parser.add_argument('--seed', help='Random seed, the same seed gives the same image.', dest="seed", type=int, default=1)
+    parser.add_argument("-v", "--version", help="Show the current version.", action="version", version=software_version)
+    parser.add_argument("-l", "--log", help="Log level:10-debug,20-info,30-warning,40-error,50-critical.", dest="log",
+                        default=20, required=False)
+
+    args = parser.parse_args()
+    logger.set_level(int(args.log))
+    args.output = os.path.abspath(args.output)
+    try:
+        BuildImage(args)
+    except Exception as ex:
+        logger.error(ex.__str__())
+        logger.error(traceback.format_exc())
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    exit(main())
@@ -5,10 +5,129 @@
 
 static const char* path = "../testcase/system.bin";
 
-int main(void)
+// usage: vs2019 [diff left_image] [-b sector_size] [-t threads] [-l layout.xml] [-e] [-q depth] [--no-mmap] [-j] [-v level] [-r journal] [-u journal] [-s sidecar] [-m manifest] [--stats] [--max-mem 64M] [image]
+int main(int argc, char* argv[])
 {
     int result = 0;
-    printf("Hello World!\n");
-    result = fatck(path, 4096);
+    int index = 0;
+    const char* image = path;
+    const char* layout = NULL;
+    const char* undo = NULL;
+    const char* diff = NULL;
+    char* unit = NULL;
+    int scale = 0;
+    fat_ck_opts_t opts = { 0 };
+    opts.sector_size = 4096;
+    opts.dev_mode = FAT_DEV_MODE_MMAP;
+    opts.threads = 0;
+    opts.io_order = false;
+    opts.queue_depth = FAT_IO_DEPTH_DEFAULT;
+    opts.report_format = FAT_REP_TEXT;
+    opts.report_level = FAT_REP_ENTRIES;
+    for (index = 1; index < argc; index++)
+    {
+        if ((strcmp(argv[index], "-b") == 0) && (index + 1 < argc))
+        {
+            // device sector size in bytes.
+            opts.sector_size = atoi(argv[++index]);
+        }
+        else if ((strcmp(argv[index], "-t") == 0) && (index + 1 < argc))
+        {
+            opts.threads = atoi(argv[++index]);
+        }
+        else if ((strcmp(argv[index], "-l") == 0) && (index + 1 < argc))
+        {
+            layout = argv[++index];
+        }
+        else if ((strcmp(argv[index], "-q") == 0) && (index + 1 < argc))
+        {
+            opts.queue_depth = (uint32_t)atoi(argv[++index]);
+        }
+        else if ((strcmp(argv[index], "-v") == 0) && (index + 1 < argc))
+        {
+            // 0 summary, 1 findings, 2 every directory entry.
+            opts.report_level = atoi(argv[++index]);
+        }
+        else if ((strcmp(argv[index], "-r") == 0) && (index + 1 < argc))
+        {
+            // repair, the undo journal is written before the image.
+            opts.journal = argv[++index];
+        }
+        else if ((strcmp(argv[index], "-u") == 0) && (index + 1 < argc))
+        {
+            // roll a repair back from its journal.
+            undo = argv[++index];
+        }
+        else if ((strcmp(argv[index], "-s") == 0) && (index + 1 < argc))
+        {
+            // incremental re-check, unchanged directories come from the sidecar.
+            opts.sidecar = argv[++index];
+        }
+        else if ((strcmp(argv[index], "-m") == 0) && (index + 1 < argc))
+        {
+            // hash file contents into a path and crc32c list.
+            opts.manifest = argv[++index];
+        }
+        else if ((strcmp(argv[index], "--max-mem") == 0) && (index + 1 < argc))
+        {
+            // memory cap of the FAT table and cluster state, K, M and G scale by 1024.
+            // below the 2 bit state map (clusters / 4 bytes) the map spills to a deleted file in TMPDIR,
+            // the least cap is then three FAT windows and a load block, 194 KB on FAT32, 339 KB on FAT16, 436 KB on FAT12.
+            opts.max_mem = strtoull(argv[++index], &unit, 10);
+            scale = unit[0] | 0x20;
+            opts.max_mem = opts.max_mem << ((scale == 'k') ? 10 : ((scale == 'm') ? 20 : ((scale == 'g') ? 30 : 0)));
+        }
+        else if ((strcmp(argv[index], "diff") == 0) && (index + 1 < argc))
+        {
+            // compare the next image against the last one.
+            diff = argv[++index];
+        }
+        else if (strcmp(argv[index], "-j") == 0)
+        {
+            // json lines report.
+            opts.report_format = FAT_REP_JSON;
+        }
+        else if (strcmp(argv[index], "--stats") == 0)
+        {
+            // counters and per phase wall times.
+            opts.stats = true;
+        }
+        else if (strcmp(argv[index], "--no-mmap") == 0)
+        {
+            // read through the block cache, -e batches then go to the async backend.
+            opts.dev_mode = FAT_DEV_MODE_READ;
+        }
+        else if (strcmp(argv[index], "-e") == 0)
+        {
+            // elevator order directory reads.
+            opts.io_order = true;
+        }
+        else
+        {
+            image = argv[index];
+        }
+    }
+    // the banner is not a record, json lines output starts with the first one.
+    if (opts.report_format == FAT_REP_TEXT)
+    {
+        printf("Hello World!\n");
+    }
+    if (undo != NULL)
+    {
+        result = fatck_undo(image, undo, opts.sector_size);
+    }
+    else if (diff != NULL)
+    {
+        result = fatck_diff(diff, image, &opts);
+    }
+    else if (layout != NULL)
+    {
+        // check every partition listed in the layout manifest.
+        result = fatck_layout(image, layout, &opts);
+    }
+    else
+    {
+        result = fatck_opts(image, &opts);
+    }
     return result;
-}
+}
\ No newline at end of file